@@ -18,6 +18,7 @@
 
 #include <access_table.h>
 #include <config.h>
+#include <config_probe.h>
 #include <database.h>
 #include <directories.h>
 #include <hash.h>
@@ -26,6 +27,7 @@
 #include <resolver.h>
 #include <settings.h>
 
+#include <boost/algorithm/string.hpp>
 #include <primitives/templates.h>
 
 #include <iostream>
@@ -97,15 +99,26 @@ String get_config()
     // but return hashed
 
     auto &db = getServiceDatabase();
-    auto h = Settings::get_local_settings().get_hash();
+    auto &ls = Settings::get_local_settings();
+    auto h = ls.get_hash();
     auto c = db.getConfigByHash(h);
 
     if (!c.empty())
         return hash_config(c);
 
-    c = test_run();
+    // explain the miss, it may cost us a test run
+    auto changed = ls.get_changed_hash_inputs();
+    if (!changed.empty())
+        LOG_INFO(logger, "-- Settings have changed: " + boost::algorithm::join(changed, ", "));
+
+    // ask compiler first, it is much faster than cmake
+    // probed config is checked after the first generate
+    c = probe_config(ls);
+    if (c.empty())
+        c = test_run();
     auto ch = hash_config(c);
     db.addConfigHash(h, c, ch);
+    ls.save_hash_inputs();
 
     return ch;
 }
@@ -132,42 +145,22 @@ int build_packages(const Config &c, const String &name)
 
         cmake_version = get_cmake_version();
         src = directories.storage_dir_cfg / bs.config / "CMakeFiles" / cmake_version;
+
+        // for storage gc
+        sdb.setConfigLastUse(bs.config);
     };
 
     set_config(get_config());
 
     // if dir does not exist it means probably we have new cmake version
-    // we have config value but there was not a test run with copying cmake prepared files
-    // so start unconditional test run
-    bool new_config = false;
-    if (!fs::exists(src))
-    {
-        auto config = test_run();
-        auto ch = hash_config(config);
-        if (bs.config != ch)
-        {
-            // the original config was detected incorrectly, re-apply
-            set_config(ch);
-            new_config = true;
-
-            // also register in db
-            auto h = Settings::get_local_settings().get_hash();
-            sdb.addConfigHash(h, config, ch);
-
-            // do we need to addConfigHash() here? like in get_config()
-            // or config must be very unique?
-        }
-
-        if (!fs::exists(src))
-            throw std::runtime_error("src dir does not exist");
-    }
+    // or the config was probed without cmake,
+    // so cmake detects everything by itself and we check the config after generating
+    const bool check_config = !fs::exists(src);
 
     // move this to printer some time
     // copy cached cmake config to bin dir
     auto dst = bs.binary_directory / "CMakeFiles" / cmake_version;
-    if (new_config)
-        fs::remove_all(dst);
-    if (!fs::exists(dst))
+    if (!check_config && !fs::exists(dst))
     {
         copy_dir(src, dst);
         // since cmake 3.8
@@ -177,11 +170,40 @@ int build_packages(const Config &c, const String &name)
     auto &ls = Settings::get_local_settings();
 
     // setup printer config
-    c.process(bs.source_directory);
     auto printer = Printer::create(ls.printerType);
-    printer->prepare_build(bs);
+    auto generate = [&]
+    {
+        c.process(bs.source_directory);
+        printer->prepare_build(bs);
+        return printer->generate(bs);
+    };
+
+    auto ret = generate();
+    if (check_config && !ret)
+    {
+        auto config = read_file(bs.binary_directory / CPPAN_CONFIG_FILENAME);
+        auto ch = hash_config(config);
+        if (!config.empty() && bs.config != ch)
+        {
+            // the original config was detected incorrectly, re-apply
+            LOG_INFO(logger, "-- Config was detected incorrectly, using: " + config);
+
+            // also register in db
+            sdb.addConfigHash(ls.get_hash(), config, ch);
+            ls.save_hash_inputs();
+
+            boost::system::error_code ec;
+            fs::remove_all(bs.binary_directory, ec);
+            set_config(ch);
+            ret = generate();
+        }
+
+        // keep prepared cmake files for the next runs
+        dst = bs.binary_directory / "CMakeFiles" / cmake_version;
+        if (!ret && !fs::exists(src) && fs::exists(dst))
+            copy_dir(dst, src);
+    }
 
-    auto ret = printer->generate(bs);
     if (ret || ls.generate_only)
         return ret;
     return printer->build(bs);
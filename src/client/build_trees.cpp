@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "build_trees.h"
+
+#include "fix_imports.h"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <primitives/command.h>
+#include <primitives/executor.h>
+#include <primitives/win32helpers.h>
+
+#include <iostream>
+#include <map>
+#include <mutex>
+
+#include <primitives/log.h>
+//DECLARE_STATIC_LOGGER(logger, "build_trees");
+
+// written by generate.cmake, one value per line
+struct BuildTreeTask
+{
+    String target;
+    path lock;
+    path from;
+    path to;
+    path import;
+    path import_fixed;
+    path aliases_file;
+    path lnk;
+    path sln;
+    Strings args; // cmake binary and its arguments
+
+    // dependencies are prepared first
+    int level = 0;
+
+    void load(const path &fn)
+    {
+        auto s = read_file(fn);
+        Strings lines;
+        boost::split(lines, s, boost::is_any_of("\n"));
+        if (lines.size() < 11)
+            throw std::runtime_error("Bad build tree task: " + fn.string());
+        size_t i = 0;
+        target = lines[i++];
+        lock = lines[i++];
+        from = lines[i++];
+        to = lines[i++];
+        import = lines[i++];
+        import_fixed = lines[i++];
+        aliases_file = lines[i++];
+        lnk = lines[i++];
+        sln = lines[i++];
+        for (; i < lines.size(); i++)
+        {
+            if (!lines[i].empty())
+                args.push_back(lines[i]);
+        }
+    }
+
+    bool prepared() const
+    {
+        // same check as in generate.cmake
+        return fs::exists(import) && fs::exists(import_fixed) &&
+            (fs::exists(to) || !fs::exists(to.parent_path()));
+    }
+
+    void run() const
+    {
+        // same lock as in generate.cmake
+        if (!fs::exists(lock))
+        {
+            fs::create_directories(lock.parent_path());
+            write_file(lock, "");
+        }
+        boost::interprocess::file_lock fl(lock.string().c_str());
+        std::unique_lock<boost::interprocess::file_lock> lk(fl);
+
+        // other process could do it already
+        if (prepared())
+            return;
+
+        // copy cmake cache for faster bootstrapping
+        if (!fs::exists(to) && !from.empty() && fs::exists(from))
+        {
+            copy_dir(from, to);
+
+            // since cmake 3.8 we must initialize CMakeCache.txt with one record in it
+            write_file(to.parent_path().parent_path() / "CMakeCache.txt", "CMAKE_PLATFORM_INFO_INITIALIZED:INTERNAL=1\n");
+        }
+
+        primitives::Command c;
+        c.args = args;
+        std::error_code ec;
+        c.execute(ec);
+        if (ec || !c.exit_code || c.exit_code.value())
+        {
+            throw std::runtime_error("Cannot prepare build tree for " + target + ": " +
+                boost::trim_copy(ec.message()) + "\n" + c.out.text + c.err.text);
+        }
+
+        fix_imports(target, aliases_file, import, import_fixed);
+
+        // ignore errors
+        if (!lnk.empty())
+            create_link(sln, lnk, "Link to CPPAN Solution");
+    }
+};
+
+void prepare_build_trees(const path &list_file)
+{
+    // build_dir<tab>parent_build_dir
+    std::map<path, BuildTreeTask> tasks;
+    std::multimap<path, path> parents;
+    for (auto &line : read_lines(list_file))
+    {
+        auto p = line.find('\t');
+        auto dir = line.substr(0, p);
+        if (dir.empty())
+            continue;
+        auto &t = tasks[dir];
+        if (t.args.empty())
+            t.load(dir + ".gen.task");
+        if (p != line.npos && p + 1 < line.size())
+            parents.emplace(dir, line.substr(p + 1));
+    }
+
+    // parent goes after all its dependencies
+    bool changed = true;
+    for (size_t n = 0; changed && n < tasks.size(); n++)
+    {
+        changed = false;
+        for (auto &p : parents)
+        {
+            auto i = tasks.find(p.second);
+            if (i == tasks.end())
+                continue;
+            auto l = tasks[p.first].level + 1;
+            if (i->second.level < l)
+            {
+                i->second.level = l;
+                changed = true;
+            }
+        }
+    }
+
+    std::map<int, std::vector<const BuildTreeTask *>> levels;
+    for (auto &t : tasks)
+        levels[t.second.level].push_back(&t.second);
+
+    std::mutex m;
+    auto &e = getExecutor();
+    for (auto &l : levels)
+    {
+        std::vector<Future<void>> futures;
+        for (auto t : l.second)
+        {
+            futures.push_back(e.push([t, &m]
+            {
+                if (t->prepared())
+                    return;
+                {
+                    std::unique_lock<std::mutex> lk(m);
+                    std::cout << "-- Preparing build tree for " << t->target << std::endl;
+                }
+                t->run();
+            }));
+        }
+        for (auto &f : futures)
+            f.wait();
+        for (auto &f : futures)
+            f.get();
+    }
+}
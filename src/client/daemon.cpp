@@ -0,0 +1,441 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "daemon.h"
+
+#include <filesystem.h>
+
+#include <boost/algorithm/string.hpp>
+#include <primitives/templates.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+#include <primitives/log.h>
+//DECLARE_STATIC_LOGGER(logger, "daemon");
+
+#define DAEMON_STOP_COMMAND "stop"
+#define DAEMON_IDLE_TIMEOUT_MINUTES 30
+// busy daemon is not waited, command is executed by the client
+#define DAEMON_ACCEPT_TIMEOUT_MS 500
+// for reading requests, so a stuck client does not block others
+#define DAEMON_READ_TIMEOUT_MS 1000
+
+#ifndef _WIN32
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+// requests are served one by one, so only short commands are sent
+static bool is_daemon_command(const Strings &args)
+{
+    static const std::set<String> commands
+    {
+        "internal-fix-imports",
+    };
+    return args.size() > 1 && commands.find(args[1]) != commands.end();
+}
+
+static path get_socket_path()
+{
+    // new client versions do not talk to old daemons
+    return fs::temp_directory_path() / ("cppan_" + std::to_string(getuid()) + "_" +
+        std::to_string(VERSION_MAJOR) + "." + std::to_string(VERSION_MINOR) + "." +
+        std::to_string(VERSION_PATCH) + "." + std::to_string(BUILD_NUMBER) + ".sock");
+}
+
+static void setup_socket(int fd)
+{
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+static void set_read_timeout(int fd, int ms)
+{
+    timeval tv = { 0 };
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+// other side of the socket is run by the same user
+static bool check_peer(int fd)
+{
+#ifdef SO_PEERCRED
+    ucred cr;
+    socklen_t len = sizeof(cr);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cr, &len) == -1)
+        return false;
+    return cr.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    if (getpeereid(fd, &uid, &gid) == -1)
+        return false;
+    return uid == getuid();
+#endif
+}
+
+static bool write_all(int fd, const void *data, size_t size)
+{
+    auto p = (const char *)data;
+    while (size)
+    {
+        auto n = send(fd, p, size, SEND_FLAGS);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *data, size_t size)
+{
+    auto p = (char *)data;
+    while (size)
+    {
+        auto n = read(fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool write_string(int fd, const String &s)
+{
+    uint32_t sz = (uint32_t)s.size();
+    return write_all(fd, &sz, sizeof(sz)) && write_all(fd, s.data(), s.size());
+}
+
+static bool read_string(int fd, String &s)
+{
+    uint32_t sz;
+    if (!read_all(fd, &sz, sizeof(sz)))
+        return false;
+    s.resize(sz);
+    return read_all(fd, &s[0], sz);
+}
+
+static bool write_strings(int fd, const Strings &v)
+{
+    uint32_t n = (uint32_t)v.size();
+    if (!write_all(fd, &n, sizeof(n)))
+        return false;
+    for (auto &s : v)
+    {
+        if (!write_string(fd, s))
+            return false;
+    }
+    return true;
+}
+
+static bool read_strings(int fd, Strings &v)
+{
+    uint32_t n;
+    if (!read_all(fd, &n, sizeof(n)))
+        return false;
+    v.resize(n);
+    for (auto &s : v)
+    {
+        if (!read_string(fd, s))
+            return false;
+    }
+    return true;
+}
+
+static Strings get_environment()
+{
+    Strings env;
+    for (auto e = environ; *e; e++)
+        env.push_back(*e);
+    return env;
+}
+
+static void set_environment(const Strings &env)
+{
+    Strings names;
+    for (auto e = environ; *e; e++)
+        names.push_back(String(*e).substr(0, String(*e).find('=')));
+    for (auto &n : names)
+        unsetenv(n.c_str());
+    for (auto &e : env)
+    {
+        auto p = e.find('=');
+        if (p != e.npos && p != 0)
+            setenv(e.substr(0, p).c_str(), e.substr(p + 1).c_str(), 1);
+    }
+}
+
+// request: cwd, env, args
+static bool write_request(int fd, const Strings &args)
+{
+    return write_string(fd, fs::current_path().string()) &&
+        write_strings(fd, get_environment()) &&
+        write_strings(fd, args);
+}
+
+static bool read_request(int fd, String &cwd, Strings &env, Strings &args)
+{
+    return read_string(fd, cwd) &&
+        read_strings(fd, env) &&
+        read_strings(fd, args) &&
+        !args.empty();
+}
+
+static int connect_daemon()
+{
+    auto fn = get_socket_path().string();
+    sockaddr_un addr = { 0 };
+    addr.sun_family = AF_UNIX;
+    if (fn.size() >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, fn.c_str());
+
+    // path is predictable, so it must be our private socket
+    struct stat st;
+    if (lstat(fn.c_str(), &st) == -1 || !S_ISSOCK(st.st_mode) ||
+        st.st_uid != getuid() || (st.st_mode & 077))
+        return -1;
+
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        return -1;
+    setup_socket(fd);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) == -1 || !check_peer(fd))
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int execute(const DaemonCommand &command, const String &cwd, const Strings &env,
+    const Strings &args, String &out, String &err)
+{
+    // output of the command is sent to the client
+    std::ostringstream sout, serr;
+    auto old_out = std::cout.rdbuf(sout.rdbuf());
+    auto old_err = std::cerr.rdbuf(serr.rdbuf());
+    auto old_env = get_environment();
+    SCOPE_EXIT
+    {
+        set_environment(old_env);
+        std::cout.rdbuf(old_out);
+        std::cerr.rdbuf(old_err);
+        out = sout.str();
+        err = serr.str();
+    };
+
+    try
+    {
+        set_environment(env);
+        ScopedCurrentPath cp(cwd, CurrentPathScope::All);
+        return command(args);
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << e.what() << "\n";
+    }
+    return 1;
+}
+
+int run_daemon(const DaemonCommand &command)
+{
+    auto cfd = connect_daemon();
+    if (cfd != -1)
+    {
+        close(cfd);
+        LOG_INFO(logger, "Daemon is already running");
+        return 0;
+    }
+
+    auto fn = get_socket_path().string();
+    sockaddr_un addr = { 0 };
+    addr.sun_family = AF_UNIX;
+    if (fn.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("Socket path is too long: " + fn);
+    strcpy(addr.sun_path, fn.c_str());
+    unlink(fn.c_str());
+
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        throw std::runtime_error("Cannot create socket");
+    SCOPE_EXIT
+    {
+        close(fd);
+        unlink(fn.c_str());
+    };
+
+    // only current user can connect
+    auto old_mask = umask(0077);
+    auto r = bind(fd, (sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+    if (r == -1 || listen(fd, 64) == -1)
+        throw std::runtime_error("Cannot listen on socket: " + fn);
+
+    LOG_INFO(logger, "Daemon is listening on " << fn);
+
+    // requests are served one by one, because they change current dir and env;
+    // clients do not wait for a busy daemon
+    while (1)
+    {
+        pollfd p = { 0 };
+        p.fd = fd;
+        p.events = POLLIN;
+        auto n = poll(&p, 1, DAEMON_IDLE_TIMEOUT_MINUTES * 60 * 1000);
+        if (n == 0)
+        {
+            LOG_INFO(logger, "Daemon is idle, exiting");
+            break;
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        auto c = accept(fd, nullptr, nullptr);
+        if (c == -1)
+            continue;
+        SCOPE_EXIT
+        {
+            close(c);
+        };
+        setup_socket(c);
+        set_read_timeout(c, DAEMON_READ_TIMEOUT_MS);
+        if (!check_peer(c))
+            continue;
+
+        String cwd;
+        Strings env, args;
+        if (!read_request(c, cwd, env, args))
+            continue;
+        if (args.size() == 1 && args[0] == DAEMON_STOP_COMMAND)
+        {
+            int32_t code = 0;
+            write_all(c, &code, sizeof(code));
+            break;
+        }
+
+        // client may have given up waiting and executed the command itself,
+        // so the command is started only after its confirmation
+        char ready = 1, go = 0;
+        if (!write_all(c, &ready, 1) || !read_all(c, &go, 1) || go != 1)
+            continue;
+
+        int32_t code = 1;
+        String out, err;
+        if (is_daemon_command(args))
+        {
+            LOG_DEBUG(logger, "Executing: " << boost::join(args, " "));
+            code = execute(command, cwd, env, args, out, err);
+        }
+        else
+            err = "command is not served by the daemon: " + (args.size() > 1 ? args[1] : "") + "\n";
+        if (write_all(c, &code, sizeof(code)) && write_string(c, out))
+            write_string(c, err);
+    }
+    return 0;
+}
+
+void stop_daemon()
+{
+    auto fd = connect_daemon();
+    if (fd == -1)
+        return;
+    write_request(fd, { DAEMON_STOP_COMMAND });
+    int32_t code;
+    read_all(fd, &code, sizeof(code));
+    close(fd);
+}
+
+optional<int> run_in_daemon(const Strings &args)
+{
+    if (!is_daemon_command(args))
+        return {};
+
+    auto fd = connect_daemon();
+    if (fd == -1)
+        return {};
+    SCOPE_EXIT
+    {
+        close(fd);
+    };
+
+    // on any error before the confirmation command is executed in this process
+    if (!write_request(fd, args))
+        return {};
+    pollfd p = { 0 };
+    p.fd = fd;
+    p.events = POLLIN;
+    char ready = 0, go = 1;
+    if (poll(&p, 1, DAEMON_ACCEPT_TIMEOUT_MS) != 1 ||
+        !read_all(fd, &ready, 1) || ready != 1 ||
+        !write_all(fd, &go, 1))
+        return {};
+
+    // command is started, so its result is waited
+    int32_t code;
+    String out, err;
+    if (!read_all(fd, &code, sizeof(code)) ||
+        !read_string(fd, out) ||
+        !read_string(fd, err))
+        throw std::runtime_error("Daemon connection is lost");
+    std::cout << out;
+    std::cerr << err;
+    return code;
+}
+
+#else
+
+int run_daemon(const DaemonCommand &)
+{
+    throw std::runtime_error("Daemon is not supported on this platform");
+}
+
+void stop_daemon()
+{
+}
+
+optional<int> run_in_daemon(const Strings &)
+{
+    return {};
+}
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cppan_string.h>
+#include <primitives/stdcompat/optional.h>
+
+#include <functional>
+
+// Local daemon keeps the process warm (settings, databases)
+// and executes short internal-* commands for thin clients.
+// Client's current dir, environment, stdout and stderr are forwarded.
+// Works over unix socket, so it is not available on Windows.
+
+using DaemonCommand = std::function<int(const Strings &args)>;
+
+// runs the daemon until it is stopped or idle for some time
+int run_daemon(const DaemonCommand &command);
+void stop_daemon();
+
+// returns exit code or nothing if the command is not served by the daemon,
+// the daemon is not running or it is busy
+optional<int> run_in_daemon(const Strings &args);
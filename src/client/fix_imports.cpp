@@ -51,6 +51,33 @@ String fix_imports(const Strings &lines_old, const String &old_target, const Str
     return ctx.getText();
 }
 
+// finds all import commands in a single pass
+// and returns them with their arguments in round brackets ()
+static Strings get_import_commands(const String &s, bool &exe)
+{
+    static const StringSet commands{ "add_library", "add_executable", "set_property", "set_target_properties" };
+
+    Strings lines;
+    size_t p = 0;
+    while ((p = s.find('(', p)) != s.npos)
+    {
+        auto b = p;
+        while (b > 0 && (isalnum((unsigned char)s[b - 1]) || s[b - 1] == '_'))
+            b--;
+        auto cmd = s.substr(b, p - b);
+        p++;
+        if (commands.find(cmd) == commands.end())
+            continue;
+        exe |= cmd == "add_executable";
+
+        // also checks that closing bracket ) is not in quotes
+        auto e = (size_t)get_end_of_string_block(s, (int)p);
+        lines.push_back(s.substr(b, e - b));
+        p = e;
+    }
+    return lines;
+}
+
 void fix_imports(const String &target, const path &aliases_file, const path &old_file, const path &new_file)
 {
     auto s = read_file(old_file);
@@ -63,47 +90,31 @@ void fix_imports(const String &target, const path &aliases_file, const path &old
     if (!ofile)
         throw std::runtime_error("Cannot open the output file for writing");
 
-    // finds all inside round brackets ()
-    // also checks that closing bracket ) is not in quotes
-    String add_library = "(add_library|add_executable|set_property|set_target_properties)\\(";
-
-    Strings lines;
-    std::regex r(add_library);
-    std::smatch m;
     bool exe = false;
-    while (std::regex_search(s, m, r))
-    {
-        exe |= m[1].str() == "add_executable";
-
-        auto b = m[1].first - s.begin();
-        auto e = get_end_of_string_block(s, (int)(m.suffix().first - s.begin()));
-
-        lines.push_back(s.substr(b, e - b));
-        s = m.suffix();
-    }
+    auto lines = get_import_commands(s, exe);
 
     // set exe imports only to release binary
     // maybe add an option for this behavior later
     auto lines_not_exe = lines;
     if (exe)
     {
-        String rel_conf = "IMPORTED_LOCATION_RELEASE";
-        String confs = "(IMPORTED_LOCATION_DEBUG|IMPORTED_LOCATION_MINSIZEREL|IMPORTED_LOCATION_RELWITHDEBINFO)";
-        String rpath = "\\s*(\".*?\")";
-        String iloc = confs + rpath;
+        static const String rel_conf = "IMPORTED_LOCATION_RELEASE";
+        static const String rpath = "\\s*(\".*?\")";
+        static const std::regex rel(rel_conf + rpath);
+        static const std::regex iloc("(IMPORTED_LOCATION_DEBUG|IMPORTED_LOCATION_MINSIZEREL|IMPORTED_LOCATION_RELWITHDEBINFO)" + rpath);
+
+        std::smatch m;
         String release_path;
         for (auto &line : lines)
         {
             if (line.find(rel_conf) != line.npos)
             {
-                r = rel_conf + rpath;
-                if (std::regex_search(line, m, r))
+                if (std::regex_search(line, m, rel))
                 {
                     release_path = m[1].str();
-                    r = iloc;
                     for (auto &line2 : lines)
                     {
-                        if (std::regex_search(line2, m, r))
+                        if (std::regex_search(line2, m, iloc))
                         {
                             String t;
                             t = m.prefix().str();
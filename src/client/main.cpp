@@ -15,14 +15,19 @@
  */
 
 #include "build.h"
+#include "build_trees.h"
+#include "daemon.h"
 #include "fix_imports.h"
 #include "options.h"
 #include "autotools.h"
 
 #include <access_table.h>
 #include <api.h>
+#include <background.h>
 #include <config.h>
 #include <database.h>
+#include <directories.h>
+#include <download.h>
 #include <exceptions.h>
 #include <filesystem.h>
 #include <hash.h>
@@ -31,6 +36,7 @@
 #include <program.h>
 #include <resolver.h>
 #include <settings.h>
+#include <storage_gc.h>
 #include <verifier.h>
 
 #include <boost/algorithm/string.hpp>
@@ -43,6 +49,7 @@
 #include <primitives/win32helpers.h>
 
 #include <iostream>
+#include <map>
 #include <thread>
 
 #include <primitives/log.h>
@@ -58,12 +65,46 @@ enum class ApiResult
 ApiResult api_call(const String &cmd, const Strings &args);
 void check_spec_file();
 void default_run();
-void init(const Strings &args, const String &log_level);
+void init(const Strings &args, const String &log_level, int startup);
 void load_current_config();
+void load_request_config(const Strings &args);
 void self_upgrade();
 void self_upgrade_copy(const path &dst);
 optional<int> internal(const Strings &args);
 void command_init(const Strings &args);
+void auto_storage_gc();
+void finish_background();
+
+// disabled for internal commands
+bool storage_gc_allowed = false;
+
+// what is initialized before running a command
+enum StartupFlags
+{
+    sfLogger            = 1 << 0,
+    sfUserSettings      = 1 << 1,
+    sfLocalConfig       = 1 << 2,
+    sfServiceDatabase   = 1 << 3,
+
+    sfAll = sfLogger | sfUserSettings | sfLocalConfig | sfServiceDatabase,
+};
+
+int get_startup_profile(const Strings &args);
+
+// --time-startup
+bool time_startup = false;
+auto startup_begin = std::chrono::steady_clock::now();
+std::vector<std::pair<String, long long>> startup_times;
+
+template <class F>
+void startup_stage(const String &name, F &&f)
+{
+    if (!time_startup)
+        return f();
+    startup_times.emplace_back(name, get_time<std::chrono::microseconds>(f));
+}
+
+void print_startup_times();
 
 int main1(int argc, char *argv[])
 try
@@ -79,6 +120,20 @@ try
     for (auto i = 0; i < argc; i++)
         args.push_back(argv[i]);
 
+    // short internal commands go to the daemon first, without any initialization
+    if (std::find(args.begin(), args.end(), "--time-startup") == args.end())
+    {
+        if (auto r = run_in_daemon(args))
+            return r.value();
+    }
+
+    int startup = sfAll;
+    SCOPE_EXIT
+    {
+        if (startup & sfLogger)
+            LOG_DEBUG(logger, "sha256 calls: " << get_sha256_count());
+    };
+
     String log_level = "info";
 
     // set correct working directory to look for config file
@@ -123,12 +178,21 @@ try
             {
                 Settings::get_user_settings().disable_update_checks = true;
             }
+
+            if (args[i] == "--time-startup"s)
+            {
+                time_startup = true;
+                args_copy.erase(std::find(args_copy.begin(), args_copy.end(), args[i]));
+            }
         }
         args = args_copy;
     }
 
     // main cppan client init routine
-    init(args, log_level);
+    startup = get_startup_profile(args);
+    init(args, log_level, startup);
+    if (time_startup)
+        print_startup_times();
 
     // default run
     if (args.size() == 1)
@@ -201,10 +265,29 @@ try
             if (cmd == "list")
             {
                 auto &db = getPackagesDatabase();
-                db.listPackages(args.size() > 2 ? args[2] : "");
+                // list [name [limit [offset]]]
+                db.listPackages(args.size() > 2 ? args[2] : "",
+                    args.size() > 3 ? std::stoi(args[3]) : 0,
+                    args.size() > 4 ? std::stoi(args[4]) : 0);
                 return 0;
             }
 
+            if (cmd == "daemon")
+            {
+                if (args.size() > 2 && args[2] == "stop")
+                {
+                    stop_daemon();
+                    return 0;
+                }
+                return run_daemon([](const Strings &args)
+                {
+                    load_request_config(args);
+                    if (auto r = internal(args))
+                        return r.value();
+                    throw std::runtime_error("Not an internal command: " + args[1]);
+                });
+            }
+
             if (cmd == "init")
             {
                 // this prevents db updating (but not initial dl) during dependency helper
@@ -339,6 +422,16 @@ try
         cleanConfigs(options[CLEAN_CONFIGS].as<Strings>());
         return 0;
     }
+    if (options().count(STORAGE_GC))
+    {
+        auto budget = options[STORAGE_GC].as<int>();
+        if (budget <= 0)
+            budget = Settings::get_user_settings().storage_gc_budget_mb;
+        if (budget <= 0)
+            throw std::runtime_error("Storage budget is not set. Pass it to --gc (in MB) or set 'storage_gc_budget_mb' in config.");
+        storage_gc(budget * 1_MB);
+        return 0;
+    }
     if (options().count("beautify"))
     {
         path p = options["beautify"].as<String>();
@@ -493,6 +586,9 @@ int main(int argc, char *argv[])
 {
 #ifndef _WIN32
     auto r = main1(argc, argv);
+    if (r == 0)
+        auto_storage_gc();
+    finish_background();
     return r;
 #else
     primitives::minidump::dir = L"cppan\\dump";
@@ -504,6 +600,9 @@ int main(int argc, char *argv[])
     __try
     {
         auto r = main1(argc, argv);
+        if (r == 0)
+            auto_storage_gc();
+        finish_background();
         return r;
     }
     __except (PRIMITIVES_GENERATE_DUMP)
@@ -549,31 +648,111 @@ void default_run()
     c.process();
 }
 
-void init(const Strings &args, const String &log_level)
+int get_startup_profile(const Strings &args)
 {
-    // initial sequence
+    // daemon serves different projects, see load_request_config()
+    if (args.size() > 1 && args[1] == "daemon")
+        return sfLogger | sfUserSettings | sfServiceDatabase;
+    if (args.size() < 2 || args[1].find("internal-") != 0)
+        return sfAll;
+
+    // internal commands are run many times during builds,
+    // so they initialize only what they touch
+    // (fix-imports prints include of the storage dir, so it needs local settings).
+    // Commands without sfUserSettings must not use storage paths or locks:
+    // global directories are filled only when settings are loaded.
+    static const std::map<String, int> profiles
+    {
+        { "internal-fix-imports", sfUserSettings | sfLocalConfig },
+        { "internal-generate-batch", sfUserSettings | sfLocalConfig },
+        { "internal-create-link-to-solution", 0 },
+        { "internal-parallel-vars-check", sfLogger | sfUserSettings | sfLocalConfig },
+        { "internal-parallel-moc", 0 },
+        { "internal-self-upgrade-copy", 0 },
+    };
+    auto i = profiles.find(args[1]);
+    if (i == profiles.end())
+        return sfLogger;
+    return i->second;
+}
 
-    LoggerSettings log_settings;
-    log_settings.log_level = log_level;
-    //log_settings.log_file = (get_root_directory() / "cppan").string();
-    log_settings.simple_logger = true;
-    log_settings.print_trace = true;
-    initLogger(log_settings);
+void print_startup_times()
+{
+    using namespace std::chrono;
 
-    // first trace message
-    LOG_TRACE(logger, "----------------------------------------");
-    LOG_TRACE(logger, "Starting cppan...");
+    auto total = duration_cast<microseconds>(steady_clock::now() - startup_begin).count();
+    for (auto &t : startup_times)
+        std::cerr << "startup: " << t.first << ": " << t.second << " us\n";
+    std::cerr << "startup: total: " << total << " us\n";
+}
 
-    // initialize CPPAN structures (settings), do not remove
-    auto &us = Settings::get_user_settings();
+void init(const Strings &args, const String &log_level, int startup)
+{
+    // initial sequence
+
+    if (startup & sfLogger)
+    {
+        startup_stage("logger", [&log_level]
+        {
+            LoggerSettings log_settings;
+            log_settings.log_level = log_level;
+            //log_settings.log_file = (get_root_directory() / "cppan").string();
+            log_settings.simple_logger = true;
+            log_settings.print_trace = true;
+            initLogger(log_settings);
+        });
+
+        // first trace message
+        LOG_TRACE(logger, "----------------------------------------");
+        LOG_TRACE(logger, "Starting cppan...");
+    }
 
-    // disable update checks for internal commands
     bool init = !(args.size() > 1 && args[1].find("internal-") == 0);
-    if (!init)
-        us.disable_update_checks = true;
 
-    load_current_config();
-    getServiceDatabase(init);
+    // settings and databases are lazy, so they are loaded on the first use;
+    // global directories are not lazy, they are set by loading settings
+    if (startup & sfUserSettings)
+    {
+        startup_stage("settings", [init]
+        {
+            // initialize CPPAN structures (settings), do not remove
+            auto &us = Settings::get_user_settings();
+
+            // disable update checks for internal commands
+            if (!init)
+                us.disable_update_checks = true;
+        });
+    }
+
+    if (startup & sfLocalConfig)
+        startup_stage("config", [] { load_current_config(); });
+    if (startup & sfServiceDatabase)
+        startup_stage("service db", [init] { getServiceDatabase(init); });
+
+    storage_gc_allowed = init;
+}
+
+void auto_storage_gc()
+{
+    if (!storage_gc_allowed)
+        return;
+
+    try
+    {
+        storage_gc_auto();
+    }
+    catch (std::exception &e)
+    {
+        // do not fail
+        LOG_WARN(logger, "Storage gc failed: " << e.what());
+    }
+}
+
+void finish_background()
+{
+    // short grace period for update checks and telemetry,
+    // their results are used on the next run
+    wait_background(std::chrono::milliseconds(500));
 }
 
 void load_current_config()
@@ -595,6 +774,21 @@ void load_current_config()
     httpSettings.proxy = Settings::get_local_settings().proxy;
 }
 
+void load_request_config(const Strings &args)
+{
+    // daemon does not load local config itself,
+    // so on the first call these are user level settings
+    static const auto user_directories = directories;
+
+    // drop settings of the previous request
+    Settings::clear_local_settings();
+    directories = user_directories;
+    httpSettings.proxy = Settings::get_local_settings().proxy;
+
+    if (get_startup_profile(args) & sfLocalConfig)
+        load_current_config();
+}
+
 void self_upgrade()
 {
 #ifdef _WIN32
@@ -609,12 +803,12 @@ void self_upgrade()
 
     auto fn = fs::temp_directory_path() / fs::unique_path();
     std::cout << "Downloading checksum file" << "\n";
-    download_file(s.remotes[0].url + client + ".md5", fn, 50_MB);
+    download_file_resumable(s.remotes[0].url + client + ".md5", fn, 50_MB);
     auto md5sum = boost::algorithm::trim_copy(read_file(fn));
 
     fn = fs::temp_directory_path() / fs::unique_path();
     std::cout << "Downloading the latest client" << "\n";
-    download_file(s.remotes[0].url + client, fn, 50_MB);
+    download_file_resumable(s.remotes[0].url + client, fn, 50_MB);
     if (md5sum != md5(fn))
         throw std::runtime_error("Downloaded bad file (md5 check failed)");
 
@@ -684,6 +878,18 @@ optional<int> internal(const Strings &args)
         return 0;
     }
 
+    if (args[1] == "internal-generate-batch")
+    {
+        if (args.size() != 3)
+        {
+            std::cout << "invalid number of arguments: " << args.size() << "\n";
+            std::cout << "usage: cppan internal-generate-batch generate.list\n";
+            return 1;
+        }
+        prepare_build_trees(trim_double_quotes(args[2]));
+        return 0;
+    }
+
     if (args[1] == "internal-create-link-to-solution")
     {
 #ifndef _WIN32
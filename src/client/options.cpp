@@ -49,11 +49,13 @@ ProgramOptions::ProgramOptions()
 
         ("verbose,v", po::bool_switch(), "verbose output")
         ("trace", po::bool_switch(), "trace output")
+        ("time-startup", po::bool_switch(), "print time spent on startup stages")
 
         ("clear-cache", po::bool_switch(), "clear CMakeCache.txt files")
         ("clear-vars-cache", po::bool_switch(), "clear checked symbols, types, includes etc.")
         (CLEAN_PACKAGES, po::value<Strings>()->multitoken(), "completely clean package files for matched regex")
         (CLEAN_CONFIGS, po::value<Strings>()->multitoken(), "clean config dirs and files")
+        (STORAGE_GC, po::value<int>()->implicit_value(0), "remove least recently used packages and configs to fit storage into the budget (MB, default is storage_gc_budget_mb setting)")
 
         ("beautify", po::value<String>(), "beautify yaml script")
         ("beautify-strict", po::value<String>(), "convert to strict cppan config")
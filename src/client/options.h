@@ -44,3 +44,4 @@ private:
 #define CLEAN_PACKAGES "clean-packages"
 #define CLEAN_CONFIGS "clean-configs"
 #define SERVER_QUERY "server-query"
+#define STORAGE_GC "gc"
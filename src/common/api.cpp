@@ -17,35 +17,33 @@
 #include "api.h"
 
 #include "http.h"
+#include "json.h"
 #include "project.h"
 #include "settings.h"
 
 #include <primitives/log.h>
 //DECLARE_STATIC_LOGGER(logger, "api");
 
-ptree api_call(const Remote &r, const String &api, ptree request)
+JsonValue api_call(const Remote &r, const String &api, JsonValue request)
 {
     if (r.user.empty())
         throw std::runtime_error("Remote user is empty");
     if (r.token.empty())
         throw std::runtime_error("Remote token is empty");
 
-    request.put("auth.user", r.user);
-    request.put("auth.token", r.token);
+    request["auth"]["user"] = r.user;
+    request["auth"]["token"] = r.token;
 
     HttpRequest req = httpSettings;
     req.type = HttpRequest::Post;
     req.url = r.url + "/api/" + api;
-    req.data = ptree2string(request);
+    req.data = request.dump();
     auto resp = url_request(req);
-    auto ret = string2ptree(resp.response);
+    auto ret = JsonValue::parse(resp.response);
     if (resp.http_code != 200)
-    {
-        auto e = ret.get<String>("error", "");
-        throw std::runtime_error(e);
-    }
+        throw std::runtime_error(ret.get("error", ""));
 
-    return string2ptree(resp.response);
+    return ret;
 }
 
 void check_relative(const Remote &r, ProjectPath &p)
@@ -57,26 +55,26 @@ void check_relative(const Remote &r, ProjectPath &p)
 void Api::add_project(const Remote &r, ProjectPath p, ProjectType t)
 {
     check_relative(r, p);
-    ptree request;
-    request.put("project", p.toString());
-    request.put("type", toIndex(t));
+    JsonValue request;
+    request["project"] = p.toString();
+    request["type"] = std::to_string(toIndex(t));
     api_call(r, "add_project", request);
 }
 
 void Api::remove_project(const Remote &r, ProjectPath p)
 {
     check_relative(r, p);
-    ptree request;
-    request.put("project", p.toString());
+    JsonValue request;
+    request["project"] = p.toString();
     api_call(r, "remove_project", request);
 }
 
 void Api::add_version(const Remote &r, ProjectPath p, const String &cppan)
 {
     check_relative(r, p);
-    ptree request;
-    request.put("project", p.toString());
-    request.put("cppan", cppan);
+    JsonValue request;
+    request["project"] = p.toString();
+    request["cppan"] = cppan;
     api_call(r, "add_version", request);
 }
 
@@ -88,11 +86,11 @@ void Api::add_version(const Remote &r, ProjectPath p, const Version &vnew)
 void Api::add_version(const Remote &r, ProjectPath p, const Version &vnew, const String &vold)
 {
     check_relative(r, p);
-    ptree request;
-    request.put("project", p.toString());
-    request.put("new", vnew.toString());
+    JsonValue request;
+    request["project"] = p.toString();
+    request["new"] = vnew.toString();
     if (!vold.empty())
-        request.put("old", vold);
+        request["old"] = vold;
     api_call(r, "add_version", request);
 }
 
@@ -101,18 +99,18 @@ void Api::update_version(const Remote &r, ProjectPath p, const Version &v)
     if (!v.isBranch())
         throw std::runtime_error("Only branches can be updated");
     check_relative(r, p);
-    ptree request;
-    request.put("project", p.toString());
-    request.put("version", v.toString());
+    JsonValue request;
+    request["project"] = p.toString();
+    request["version"] = v.toString();
     api_call(r, "update_version", request);
 }
 
 void Api::remove_version(const Remote &r, ProjectPath p, const Version &v)
 {
     check_relative(r, p);
-    ptree request;
-    request.put("project", p.toString());
-    request.put("version", v.toString());
+    JsonValue request;
+    request["project"] = p.toString();
+    request["version"] = v.toString();
     api_call(r, "remove_version", request);
 }
 
@@ -121,16 +119,15 @@ void Api::get_notifications(const Remote &r, int n)
     if (n < 0)
         return;
 
-    ptree request;
-    request.put("n", n);
+    JsonValue request;
+    request["n"] = std::to_string(n);
     auto response = api_call(r, "get_notifications", request);
-    auto notifications = response.get_child("notifications");
     int i = 1;
-    for (auto &n : notifications)
+    for (auto &n : response.at("notifications").getArray())
     {
-        auto nt = (NotificationType)n.second.get<int>("type", 0);
-        auto t = n.second.get<String>("text", "");
-        auto ts = n.second.get<String>("timestamp", "");
+        auto nt = (NotificationType)n.get<int>("type", 0);
+        auto t = n.get("text", "");
+        auto ts = n.get("timestamp", "");
 
         std::ostringstream ss;
         ss << i++ << " ";
@@ -157,6 +154,6 @@ void Api::get_notifications(const Remote &r, int n)
 
 void Api::clear_notifications(const Remote &r)
 {
-    ptree request;
+    JsonValue request;
     api_call(r, "clear_notifications", request);
 }
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "archive_provider.h"
+
+#include <fmt/format.h>
+
+ArchiveProviders get_default_archive_providers()
+{
+    return {
+        { "github.com", "{url}/archive/{ref}.tar.gz" },
+        { "gitlab.com", "{url}/-/archive/{ref}/{name}-{ref}.tar.gz" },
+        { "bitbucket.org", "{url}/get/{ref}.tar.gz" },
+        { "codeberg.org", "{url}/archive/{ref}.tar.gz" },
+    };
+}
+
+String get_archive_url(const ArchiveProviders &providers, const String &url, const String &ref)
+{
+    if (ref.empty())
+        return String();
+
+    // only http(s) urls, ssh ones need credentials
+    auto p = url.find("://");
+    if (p == url.npos || url.compare(0, 4, "http") != 0)
+        return String();
+    p += 3;
+    auto host = url.substr(p, url.find('/', p) - p);
+
+    auto i = providers.find(host);
+    if (i == providers.end())
+        return String();
+
+    auto u = url;
+    while (!u.empty() && u.back() == '/')
+        u.pop_back();
+    const String suffix = ".git";
+    if (u.size() > suffix.size() && u.compare(u.size() - suffix.size(), suffix.size(), suffix) == 0)
+        u.resize(u.size() - suffix.size());
+    auto name = u.substr(u.rfind('/') + 1);
+
+    return fmt::format(i->second,
+        fmt::arg("url", u),
+        fmt::arg("name", name),
+        fmt::arg("ref", ref)
+    );
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "cppan_string.h"
+
+#include <map>
+
+// Archive providers make an url of a source archive from a repository url,
+// so sources are downloaded without cloning.
+// Templates are keyed by host of the repository url and may use
+//  {url}  - repository url without .git suffix
+//  {name} - last component of the url
+//  {ref}  - tag, branch or commit
+using ArchiveProviders = std::map<String, String>;
+
+ArchiveProviders get_default_archive_providers();
+
+// returns empty string when there is no provider for the url
+String get_archive_url(const ArchiveProviders &providers, const String &url, const String &ref);
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "background.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <primitives/log.h>
+//DECLARE_STATIC_LOGGER(logger, "background");
+
+using BackgroundClock = std::chrono::steady_clock;
+
+struct BackgroundTaskState
+{
+    std::thread t;
+    std::atomic_bool cancel{ false };
+    bool done = false;
+    BackgroundClock::time_point deadline;
+};
+
+static std::mutex m;
+static std::condition_variable cv;
+static std::list<std::unique_ptr<BackgroundTaskState>> tasks;
+
+void run_background(BackgroundTask task, std::chrono::milliseconds deadline)
+{
+    std::unique_lock<std::mutex> lk(m);
+
+    // long running processes (daemon) start many tasks
+    tasks.remove_if([](const auto &s)
+    {
+        if (!s->done)
+            return false;
+        s->t.join();
+        return true;
+    });
+
+    auto s = std::make_unique<BackgroundTaskState>();
+    s->deadline = BackgroundClock::now() + deadline;
+    auto p = s.get();
+    p->t = std::thread([p, task = std::move(task)]
+    {
+        try
+        {
+            task(p->cancel);
+        }
+        catch (std::exception &e)
+        {
+            LOG_DEBUG(logger, "Background task failed: " << e.what());
+        }
+        catch (...)
+        {
+        }
+
+        std::unique_lock<std::mutex> lk(m);
+        p->done = true;
+        cv.notify_all();
+    });
+    tasks.push_back(std::move(s));
+}
+
+void wait_background(std::chrono::milliseconds max_wait)
+{
+    std::unique_lock<std::mutex> lk(m);
+    auto until = BackgroundClock::now() + max_wait;
+    for (auto &s : tasks)
+    {
+        cv.wait_until(lk, std::min(until, s->deadline), [&s] { return s->done; });
+        s->cancel = true;
+    }
+    auto ts = std::move(tasks);
+    tasks.clear();
+    lk.unlock();
+
+    for (auto &s : ts)
+        s->t.join();
+}
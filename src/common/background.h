@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+using BackgroundTask = std::function<void(const std::atomic_bool &cancel)>;
+
+// Runs the task in a separate thread, the caller is never blocked.
+// Network requests of the task must be aborted when cancel is set
+// and should not last longer than the deadline.
+void run_background(BackgroundTask task,
+    std::chrono::milliseconds deadline = std::chrono::seconds(3));
+
+// Waits for unfinished tasks until their deadlines, but not longer than max_wait,
+// then cancels the rest and joins them. Called at exit.
+void wait_background(std::chrono::milliseconds max_wait);
@@ -993,7 +993,7 @@ String CheckParameters::getHash() const
     ADD_PARAMS(include_directories);
     ADD_PARAMS(libraries);
     ADD_PARAMS(flags);
-    h = sha256(h);
+    h = sha256_counted(h);
     h = h.substr(0, 4);
     return h;
 }
@@ -48,6 +48,14 @@ Config::Config(const path &p, bool local)
     reload(p);
 }
 
+Config::Config(const path &p, const path &cache_fn)
+    : Config()
+{
+    is_local = false;
+    this->cache_fn = cache_fn;
+    reload(p);
+}
+
 void Config::reload(const path &p)
 {
     if (fs::is_directory(p))
@@ -91,7 +99,7 @@ void Config::load_current_config_settings()
 
 void Config::load(const path &p)
 {
-    auto root = load_yaml_config(p);
+    auto root = cache_fn.empty() ? load_yaml_config(p) : load_yaml_config(p, cache_fn);
     load(root);
 }
 
@@ -32,6 +32,8 @@ struct Config
 {
     Config();
     Config(const path &p, bool local = true);
+    // downloaded package config with binary cache of the yaml
+    Config(const path &p, const path &cache_fn);
 
     void load(const yaml &root);
     void load(const path &p);
@@ -66,6 +68,7 @@ struct Config
 private:
     Projects projects;
     path dir; // cwd
+    path cache_fn;
 
     void addDefaultProject();
     Project &getProject1(const ProjectPath &ppath);
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config_probe.h"
+
+#include "settings.h"
+
+#include <boost/algorithm/string.hpp>
+#include <primitives/command.h>
+
+#include <map>
+
+#ifndef _WIN32
+#include <sys/utsname.h>
+#endif
+
+#include <primitives/log.h>
+//DECLARE_STATIC_LOGGER(logger, "config_probe");
+
+#define CPPAN_CONFIG_PART_DELIMETER "-"
+
+// same as prepare_config_part() in functions.cmake
+static String config_part(String s)
+{
+    boost::replace_all(s, " ", "_");
+    boost::replace_all(s, CPPAN_CONFIG_PART_DELIMETER, "_");
+    boost::to_lower(s);
+    return s;
+}
+
+static String run(const Strings &args)
+{
+    primitives::Command c;
+    c.args = args;
+    std::error_code ec;
+    c.execute(ec);
+    if (ec || !c.exit_code || c.exit_code.value())
+        return String();
+    return boost::trim_copy(c.out.text);
+}
+
+static std::map<String, String> get_predefined_macros(const String &cxx)
+{
+    std::map<String, String> macros;
+    for (auto &line : split_lines(run({ cxx, "-dM", "-E", "-x", "c++", "/dev/null" })))
+    {
+        // #define NAME VALUE
+        auto ss = split_string(line, " ");
+        if (ss.size() > 1 && ss[0] == "#define")
+            macros[ss[1]] = ss.size() > 2 ? ss[2] : "";
+    }
+    return macros;
+}
+
+String probe_config(const Settings &s)
+{
+#if defined(_WIN32) || defined(__APPLE__)
+    // msvc, xcode and system versions are known to cmake only
+    return String();
+#else
+    // anything that could change compiler detection in cmake
+    if (!s.toolset.empty() || !s.system_version.empty() ||
+        !s.cmake_options.empty() || !s.env.empty() ||
+        getenv("CMAKE_TOOLCHAIN_FILE") || getenv("CFLAGS") || getenv("CXXFLAGS"))
+        return String();
+    if (!s.c_compiler_flags.empty() || !s.cxx_compiler_flags.empty() || !s.compiler_flags.empty())
+        return String();
+    for (int i = 0; i < Settings::CMakeConfigurationType::Max; i++)
+    {
+        if (!s.c_compiler_flags_conf[i].empty() || !s.cxx_compiler_flags_conf[i].empty() ||
+            !s.compiler_flags_conf[i].empty())
+            return String();
+    }
+
+    auto generator = s.generator;
+    if (generator.empty())
+    {
+        auto e = getenv("CMAKE_GENERATOR");
+        generator = e ? e : "Unix Makefiles";
+    }
+    if (generator != "Unix Makefiles" && generator != "Ninja")
+        return String();
+
+    // same search order as in cmake
+    String cxx = s.cxx_compiler;
+    if (cxx.empty())
+    {
+        if (auto e = getenv("CXX"))
+            cxx = e;
+    }
+    if (cxx.empty())
+    {
+        for (auto &c : { "c++", "g++", "clang++" })
+        {
+            if (!primitives::resolve_executable(c).empty())
+            {
+                cxx = c;
+                break;
+            }
+        }
+    }
+    if (cxx.empty())
+        return String();
+
+    utsname u;
+    if (uname(&u))
+        return String();
+    auto system = config_part(u.sysname);
+
+    // cross compilers are left to cmake
+    auto target = boost::to_lower_copy(run({ cxx, "-dumpmachine" }));
+    if (target.find(system) == target.npos)
+        return String();
+
+    auto macros = get_predefined_macros(cxx);
+    auto m = [&macros](const String &name)
+    {
+        auto i = macros.find(name);
+        return i == macros.end() ? String() : i->second;
+    };
+
+    String compiler, version;
+    if (!m("__INTEL_COMPILER").empty() || !m("__apple_build_version__").empty())
+        return String();
+    if (!m("__clang__").empty())
+    {
+        compiler = "clang";
+        version = m("__clang_major__") + "." + m("__clang_minor__");
+    }
+    else if (!m("__GNUC__").empty())
+    {
+        compiler = "gnu";
+        version = m("__GNUC__") + "." + m("__GNUC_MINOR__");
+    }
+    else
+        return String();
+
+    auto ptr = m("__SIZEOF_POINTER__");
+    if (ptr.empty() || version.size() < 3)
+        return String();
+
+#define ADD_PART(x) config += CPPAN_CONFIG_PART_DELIMETER + (x)
+    String config = system;
+    ADD_PART(config_part(u.machine));
+    ADD_PART(compiler);
+    ADD_PART(version);
+    ADD_PART(std::to_string(std::stoi(ptr) * 8));
+    if (s.use_shared_libs)
+        config += CPPAN_CONFIG_PART_DELIMETER "dll";
+    if (!s.configuration.empty())
+        ADD_PART(s.configuration);
+    ADD_PART(config_part(generator));
+#undef ADD_PART
+
+    LOG_DEBUG(logger, "Probed config: " << config);
+    return config;
+#endif
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config_summary.h"
+
+#include "config.h"
+
+#include <boost/algorithm/string.hpp>
+
+#include <sstream>
+
+// increase when format changes
+#define CONFIG_SUMMARY_VERSION 1
+
+ConfigSummary::ConfigSummary(const Config &c, const Package &pkg)
+{
+    auto &p = c.getDefaultProject(pkg.ppath);
+    dependencies = p.dependencies;
+    aliases = p.aliases;
+    condition = p.condition;
+    root_directory = p.root_directory;
+    type = p.type;
+    header_only = pkg.flags[pfHeaderOnly];
+    build_dependencies_with_same_config = p.build_dependencies_with_same_config;
+    has_checks = !p.checks.empty();
+}
+
+String ConfigSummary::save() const
+{
+    // one value per line
+    auto line = [](String s)
+    {
+        boost::replace_all(s, "\n", " ");
+        return s + "\n";
+    };
+
+    String s;
+    s += line(std::to_string(CONFIG_SUMMARY_VERSION));
+    s += line(std::to_string((int)type));
+    s += line(std::to_string(header_only));
+    s += line(std::to_string(build_dependencies_with_same_config));
+    s += line(std::to_string(has_checks));
+    s += line(normalize_path(root_directory));
+    s += line(condition);
+    s += line(std::to_string(aliases.size()));
+    for (auto &a : aliases)
+        s += line(a);
+    s += line(std::to_string(dependencies.size()));
+    for (auto &d : dependencies)
+    {
+        s += line(d.second.ppath.toString());
+        s += line(d.second.version.toAnyVersion());
+        s += line(std::to_string(d.second.flags.to_ullong()));
+    }
+    return s;
+}
+
+bool ConfigSummary::load(const String &s)
+{
+    std::istringstream ss(s);
+    String l;
+    auto next = [&ss, &l]() -> const String &
+    {
+        if (!std::getline(ss, l))
+            throw std::runtime_error("Unexpected end of config summary");
+        return l;
+    };
+
+    try
+    {
+        if (std::stoi(next()) != CONFIG_SUMMARY_VERSION)
+            return false;
+        type = (ProjectType)std::stoi(next());
+        header_only = std::stoi(next()) != 0;
+        build_dependencies_with_same_config = std::stoi(next()) != 0;
+        has_checks = std::stoi(next()) != 0;
+        root_directory = next();
+        condition = next();
+        auto n = std::stoull(next());
+        aliases.clear();
+        while (n--)
+            aliases.insert(next());
+        n = std::stoull(next());
+        dependencies.clear();
+        while (n--)
+        {
+            Package d;
+            d.ppath = next();
+            d.version = next();
+            d.flags = std::stoull(next());
+            d.createNames();
+            dependencies.emplace(d.ppath.toString(), d);
+        }
+    }
+    catch (std::exception &)
+    {
+        return false;
+    }
+    return true;
+}
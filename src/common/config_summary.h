@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "cppan_string.h"
+#include "enums.h"
+#include "filesystem.h"
+#include "package.h"
+
+struct Config;
+
+// Cheap part of the package config.
+// It is enough to resolve dependencies and to answer questions
+// of other packages, so the full config is loaded only when
+// its own files must be printed.
+struct ConfigSummary
+{
+    Packages dependencies;
+    StringSet aliases;
+    String condition;
+    path root_directory;
+    ProjectType type{ ProjectType::Executable };
+    bool header_only = false;
+    bool build_dependencies_with_same_config = false;
+    bool has_checks = false;
+
+    ConfigSummary() = default;
+    ConfigSummary(const Config &c, const Package &pkg);
+
+    String save() const;
+    // returns false on unknown format
+    bool load(const String &s);
+};
@@ -16,11 +16,14 @@
 
 #include "database.h"
 
+#include "background.h"
 #include "directories.h"
+#include "download.h"
 #include "exceptions.h"
 #include "enums.h"
 #include "hash.h"
 #include "http.h"
+#include "http_session.h"
 #include "lock.h"
 #include "settings.h"
 #include "sqlite_database.h"
@@ -37,7 +40,7 @@
 #include <boost/nowide/fstream.hpp>
 #include <sqlite3.h>
 
-#include <shared_mutex>
+#include <deque>
 
 #include <primitives/log.h>
 //DECLARE_STATIC_LOGGER(logger, "db");
@@ -47,6 +50,7 @@
 #define PACKAGES_DB_SCHEMA_VERSION 1
 #define PACKAGES_DB_SCHEMA_VERSION_FILE "schema.version"
 #define PACKAGES_DB_VERSION_FILE "db.version"
+#define PACKAGES_DB_REMOTE_VERSION_FILE "remote.version"
 #define PACKAGES_DB_DOWNLOAD_TIME_FILE "packages.time"
 
 const String db_repo_url = "https://github.com/cppan/database";
@@ -190,6 +194,54 @@ const TableDescriptors &get_service_tables()
                 PRIMARY KEY ("tbl")
             );
         )"},
+
+        {"InstalledPackagesLastUse",
+         R"(
+            CREATE TABLE "InstalledPackagesLastUse" (
+                "package" TEXT NOT NULL,
+                "version" TEXT NOT NULL,
+                "last_use" INTEGER NOT NULL,
+                PRIMARY KEY ("package", "version")
+            );
+        )"},
+
+        {"ConfigsLastUse",
+         R"(
+            CREATE TABLE "ConfigsLastUse" (
+                "config_hash" TEXT NOT NULL,
+                "last_use" INTEGER NOT NULL,
+                PRIMARY KEY ("config_hash")
+            );
+        )"},
+        {"ConfigSummaries",
+         R"(
+            CREATE TABLE "ConfigSummaries" (
+                "package" TEXT NOT NULL,
+                "hash" TEXT NOT NULL,
+                "summary" TEXT NOT NULL,
+                PRIMARY KEY ("package")
+            );
+        )"},
+        {"RemotesHealth",
+         R"(
+            CREATE TABLE "RemotesHealth" (
+                "url" TEXT NOT NULL,
+                "latency" INTEGER NOT NULL,
+                "failures" INTEGER NOT NULL,
+                "last_failure" INTEGER NOT NULL,
+                PRIMARY KEY ("url")
+            );
+        )"},
+        {"DownloadSourcesStats",
+         R"(
+            CREATE TABLE "DownloadSourcesStats" (
+                "host" TEXT NOT NULL,
+                "throughput" INTEGER NOT NULL,
+                "failures" INTEGER NOT NULL,
+                "last_failure" INTEGER NOT NULL,
+                PRIMARY KEY ("host")
+            );
+        )"},
     };
     return service_tables;
 }
@@ -357,16 +409,75 @@ ServiceDatabase::ServiceDatabase()
 
 void ServiceDatabase::init()
 {
+    // out of RUN_ONCE because startup actions may try to init sdb again
+    static bool checked = false;
+    if (!checked)
+    {
+        checked = true;
+        registerCmakePackage();
+        auto t = get_time<std::chrono::microseconds>([this] { checkVersion(); });
+        LOG_TRACE(logger, "Service database startup check: " << t << " us");
+    }
+
     RUN_ONCE
     {
-        createTables();
-        checkStamp();
         increaseNumberOfRuns();
         checkForUpdates();
     };
+}
 
-    // move out of RUN_ONCE because it may try to init sdb again
-    performStartupActions();
+int ServiceDatabase::getStartupVersion() const
+{
+    // everything that may require migration on startup
+    String s = cppan_stamp;
+    for (auto &td : tds)
+        s += td.name + td.query;
+    for (auto &a : startup_actions)
+        s += std::to_string(a.id) + " " + std::to_string(a.action) + "\n";
+
+    // user_version is a signed 32-bit integer, 0 is a fresh db
+    return std::stoi(sha256_counted(s).substr(0, 7), nullptr, 16) | 1;
+}
+
+int ServiceDatabase::getUserVersion() const
+{
+    int v = 0;
+    db->execute("PRAGMA user_version;", [&v](SQLITE_CALLBACK_ARGS)
+    {
+        v = std::stoi(cols[0]);
+        return 0;
+    });
+    return v;
+}
+
+void ServiceDatabase::checkVersion() const
+{
+    // fast path: single query when nothing changed
+    auto v = getStartupVersion();
+    if (getUserVersion() == v)
+        return;
+
+    // other processes wait here until migration is done
+    // (sqlite does not wait for a write transaction by itself)
+    ScopedFileLock lock(fn);
+    db->execute("BEGIN IMMEDIATE;");
+    try
+    {
+        if (getUserVersion() != v)
+        {
+            createTables();
+            checkStamp();
+            // on failure actions are retried on the next run
+            if (performStartupActions())
+                db->execute("PRAGMA user_version = " + std::to_string(v) + ";");
+        }
+        db->execute("COMMIT;");
+    }
+    catch (...)
+    {
+        db->execute("ROLLBACK;", {}, true);
+        throw;
+    }
 }
 
 void ServiceDatabase::createTables() const
@@ -375,13 +486,13 @@ void ServiceDatabase::createTables() const
     if (created)
     {
         for (auto &td : tds)
-            setTableHash(td.name, sha256(td.query));
+            setTableHash(td.name, sha256_counted(td.query));
     }
 
     auto create_table = [this](const auto &td)
     {
         db->execute(td.query);
-        setTableHash(td.name, sha256(td.query));
+        setTableHash(td.name, sha256_counted(td.query));
     };
 
     // TableHashes first, out of order
@@ -405,7 +516,7 @@ void ServiceDatabase::recreateTable(const TableDescriptor &td) const
 {
     db->dropTable(td.name);
     db->execute(td.query);
-    setTableHash(td.name, sha256(td.query));
+    setTableHash(td.name, sha256_counted(td.query));
 }
 
 void ServiceDatabase::checkStamp() const
@@ -431,21 +542,20 @@ void ServiceDatabase::checkStamp() const
     clearFileStamps();
 }
 
-void ServiceDatabase::performStartupActions() const
+bool ServiceDatabase::performStartupActions() const
 {
-    registerCmakePackage();
-
     // perform startup actions on client update
     try
     {
         static bool once = false;
         if (once)
-            return;
+            return true;
 
+        auto performed = getPerformedActions();
         std::set<int> actions_performed; // prevent multiple execution of the same actions
         for (auto &a : startup_actions)
         {
-            if (isActionPerformed(a))
+            if (performed.find({ a.id, a.action }) != performed.end())
                 continue;
 
             if (actions_performed.find(a.action) != actions_performed.end())
@@ -458,9 +568,6 @@ void ServiceDatabase::performStartupActions() const
                 LOG_INFO(logger, "Initializing storage");
             once = true;
 
-            actions_performed.insert(a.action);
-            setActionPerformed(a);
-
             // do actions
             if (a.action & StartupAction::ClearCache)
             {
@@ -482,10 +589,11 @@ void ServiceDatabase::performStartupActions() const
                 createTables();
 
                 // re-create changed tables
+                auto hashes = getTableHashes();
                 for (auto &td : tds)
                 {
-                    auto h = sha256(td.query);
-                    if (getTableHash(td.name) == h)
+                    auto h = sha256_counted(td.query);
+                    if (hashes[td.name] == h)
                         continue;
                     db->dropTable(td.name);
                     db->execute(td.query);
@@ -535,36 +643,42 @@ void ServiceDatabase::performStartupActions() const
                         fs::remove_all(i);
                 }
             }
+
+            // failed action is not marked, so it is retried on the next run
+            actions_performed.insert(a.action);
+            setActionPerformed(a);
         }
     }
     catch (std::exception &e)
     {
         // do not fail
         LOG_WARN(logger, "Warning: " << e.what());
+        return false;
     }
+    return true;
 }
 
 void ServiceDatabase::checkForUpdates() const
 {
     using namespace std::literals;
 
+    // result of the previous check
+    auto &us = Settings::get_user_settings();
+    us.checkForUpdates();
+    if (us.disable_update_checks)
+        return;
+
     auto last_check = getLastClientUpdateCheck();
     auto d = Clock::now() - last_check;
     if (d < 3h)
         return;
 
-    try
+    // set before the check, so other processes won't start it too
+    setLastClientUpdateCheck();
+    run_background([&us](const auto &cancel)
     {
-        // if there are updates, set next check (and notification) in 20 mins
-        // to issue a message every run
-        if (Settings::get_user_settings().checkForUpdates())
-            setLastClientUpdateCheck(last_check + 20min);
-        else
-            setLastClientUpdateCheck();
-    }
-    catch (...)
-    {
-    }
+        us.updateClientStamp(cancel);
+    });
 }
 
 TimePoint ServiceDatabase::getLastClientUpdateCheck() const
@@ -597,6 +711,18 @@ String ServiceDatabase::getTableHash(const String &table) const
     return h;
 }
 
+std::unordered_map<String, String> ServiceDatabase::getTableHashes() const
+{
+    std::unordered_map<String, String> hashes;
+    db->execute("select tbl, hash from TableHashes",
+        [&hashes](SQLITE_CALLBACK_ARGS)
+    {
+        hashes[cols[0]] = cols[1];
+        return 0;
+    });
+    return hashes;
+}
+
 void ServiceDatabase::setTableHash(const String &table, const String &hash) const
 {
     db->execute("replace into TableHashes values ('" + table + "', '" + hash + "')");
@@ -659,6 +785,31 @@ bool ServiceDatabase::isActionPerformed(const StartupAction &action) const
     return n == 1;
 }
 
+std::set<std::pair<int, int>> ServiceDatabase::getPerformedActions() const
+{
+    std::set<std::pair<int, int>> actions;
+    try
+    {
+        db->execute("select id, action from StartupActions",
+            [&actions](SQLITE_CALLBACK_ARGS)
+        {
+            actions.emplace(std::stoi(cols[0]), std::stoi(cols[1]));
+            return 0;
+        });
+    }
+    catch (const std::exception&)
+    {
+        // if error is in StartupActions, recreate it
+        auto th = std::find_if(tds.begin(), tds.end(), [](const auto &td)
+        {
+            return td.name == "StartupActions";
+        });
+        recreateTable(*th);
+        actions.clear();
+    }
+    return actions;
+}
+
 void ServiceDatabase::setActionPerformed(const StartupAction &action) const
 {
     db->execute("insert into StartupActions values ('" +
@@ -726,6 +877,102 @@ void ServiceDatabase::addConfigHash(const String &settings_hash, const String &c
 void ServiceDatabase::removeConfigHashes(const String &h) const
 {
     db->execute("delete from ConfigHashes where config_hash = '" + h + "'");
+    db->execute("delete from ConfigsLastUse where config_hash = '" + h + "'");
+}
+
+void ServiceDatabase::setConfigLastUse(const String &config_hash, const TimePoint &p) const
+{
+    if (config_hash.empty())
+        return;
+    db->execute("replace into ConfigsLastUse values ('" + config_hash + "', '" +
+        std::to_string(Clock::to_time_t(p)) + "')");
+}
+
+std::unordered_map<String, TimePoint> ServiceDatabase::getConfigsLastUse() const
+{
+    std::unordered_map<String, TimePoint> configs;
+    db->execute("select config_hash, last_use from ConfigsLastUse",
+        [&configs](SQLITE_CALLBACK_ARGS)
+    {
+        configs[cols[0]] = Clock::from_time_t(std::stoll(cols[1]));
+        return 0;
+    });
+    return configs;
+}
+
+ServiceDatabase::ConfigSummaries ServiceDatabase::getConfigSummaries() const
+{
+    ConfigSummaries summaries;
+    db->execute("select package, hash, summary from ConfigSummaries",
+        [&summaries](SQLITE_CALLBACK_ARGS)
+    {
+        summaries[cols[0]] = { cols[1], cols[2] };
+        return 0;
+    });
+    return summaries;
+}
+
+void ServiceDatabase::setConfigSummaries(const ConfigSummaries &summaries) const
+{
+    if (summaries.empty())
+        return;
+    String q = "replace into ConfigSummaries values ";
+    for (auto &s : summaries)
+    {
+        auto summary = s.second.second;
+        boost::replace_all(summary, "'", "''");
+        q += "('" + s.first + "', '" + s.second.first + "', '" + summary + "'),";
+    }
+    q.resize(q.size() - 1);
+    db->execute(q);
+}
+
+RemotesHealth ServiceDatabase::getRemotesHealth() const
+{
+    RemotesHealth health;
+    db->execute("select url, latency, failures, last_failure from RemotesHealth",
+        [&health](SQLITE_CALLBACK_ARGS)
+    {
+        auto &h = health[cols[0]];
+        h.latency = std::stoi(cols[1]);
+        h.failures = std::stoi(cols[2]);
+        h.last_failure = Clock::from_time_t(std::stoll(cols[3]));
+        return 0;
+    });
+    return health;
+}
+
+void ServiceDatabase::setRemoteHealth(const String &url, const RemoteHealth &h) const
+{
+    auto u = url;
+    boost::replace_all(u, "'", "''");
+    db->execute("replace into RemotesHealth values ('" + u + "', " +
+        std::to_string(h.latency) + ", " + std::to_string(h.failures) + ", " +
+        std::to_string(Clock::to_time_t(h.last_failure)) + ")");
+}
+
+DownloadSourcesStats ServiceDatabase::getDownloadSourcesStats() const
+{
+    DownloadSourcesStats stats;
+    db->execute("select host, throughput, failures, last_failure from DownloadSourcesStats",
+        [&stats](SQLITE_CALLBACK_ARGS)
+    {
+        auto &s = stats[cols[0]];
+        s.throughput = std::stoll(cols[1]);
+        s.failures = std::stoi(cols[2]);
+        s.last_failure = Clock::from_time_t(std::stoll(cols[3]));
+        return 0;
+    });
+    return stats;
+}
+
+void ServiceDatabase::setDownloadSourceStats(const String &host, const DownloadSourceStats &s) const
+{
+    auto h = host;
+    boost::replace_all(h, "'", "''");
+    db->execute("replace into DownloadSourcesStats values ('" + h + "', " +
+        std::to_string(s.throughput) + ", " + std::to_string(s.failures) + ", " +
+        std::to_string(Clock::to_time_t(s.last_failure)) + ")");
 }
 
 void ServiceDatabase::setPackageDependenciesHash(const Package &p, const String &hash) const
@@ -824,6 +1071,64 @@ void ServiceDatabase::addInstalledPackage(const Package &p) const
 void ServiceDatabase::removeInstalledPackage(const Package &p) const
 {
     db->execute("delete from InstalledPackages where package = '" + p.ppath.toString() + "' and version = '" + p.version.toString() + "'");
+    db->execute("delete from InstalledPackagesLastUse where package = '" + p.ppath.toString() + "' and version = '" + p.version.toString() + "'");
+}
+
+void ServiceDatabase::setPackagesLastUse(const PackagesSet &pkgs, const TimePoint &p) const
+{
+    if (pkgs.empty())
+        return;
+    auto t = std::to_string(Clock::to_time_t(p));
+    String q = "replace into InstalledPackagesLastUse values ";
+    for (auto &pkg : pkgs)
+        q += "('" + pkg.ppath.toString() + "', '" + pkg.version.toString() + "', '" + t + "'),";
+    q.resize(q.size() - 1);
+    q += ";";
+    db->execute(q);
+}
+
+void ServiceDatabase::updateCleanedPackages(const PackagesSet &removed, const std::unordered_map<Package, String> &dependencies_hashes) const
+{
+    if (removed.empty() && dependencies_hashes.empty())
+        return;
+
+    // single statement, so no one can interleave with us
+    String q = "BEGIN;\n";
+    for (auto &p : removed)
+    {
+        auto where = "package = '" + p.ppath.toString() + "' and version = '" + p.version.toString() + "'";
+        auto id = "select id from InstalledPackages where " + where;
+        q += "delete from SourceGroupFiles where source_group_id in (select id from SourceGroups where package_id in (" + id + "));\n";
+        q += "delete from SourceGroups where package_id in (" + id + ");\n";
+        q += "delete from InstalledPackages where " + where + ";\n";
+        q += "delete from InstalledPackagesLastUse where " + where + ";\n";
+    }
+    for (auto &h : dependencies_hashes)
+        q += "replace into PackageDependenciesHashes values ('" + h.first.target_name + "', '" + h.second + "');\n";
+    q += "COMMIT;";
+
+    String err;
+    if (!db->execute(q, nullptr, true, &err))
+    {
+        db->execute("ROLLBACK;", nullptr, true);
+        throw std::runtime_error(err);
+    }
+}
+
+std::unordered_map<Package, TimePoint> ServiceDatabase::getPackagesLastUse() const
+{
+    std::unordered_map<Package, TimePoint> pkgs;
+    db->execute("select package, version, last_use from InstalledPackagesLastUse",
+        [&pkgs](SQLITE_CALLBACK_ARGS)
+    {
+        Package pkg;
+        pkg.ppath = String(cols[0]);
+        pkg.version = String(cols[1]);
+        pkg.createNames();
+        pkgs[pkg] = Clock::from_time_t(std::stoll(cols[2]));
+        return 0;
+    });
+    return pkgs;
 }
 
 String ServiceDatabase::getInstalledPackageHash(const Package &p) const
@@ -896,17 +1201,34 @@ void PackagesDatabase::init()
     }
     else if (Settings::get_system_settings().can_update_packages_db && isCurrentDbOld())
     {
-        LOG_DEBUG(logger, "Checking remote version");
+        // remote version is checked in background,
+        // so the result of the previous check is used
+        auto remote_version_file = db_dir / PACKAGES_DB_REMOTE_VERSION_FILE;
         int version_remote = 0;
         try
         {
-            version_remote = std::stoi(download_file(db_version_url));
+            if (fs::exists(remote_version_file))
+                version_remote = std::stoi(read_file(remote_version_file));
         }
-        catch (std::exception &e)
+        catch (std::exception &)
         {
-            LOG_DEBUG(logger, "Couldn't download db version file: " << e.what());
         }
-        if (version_remote > readPackagesDbVersion(db_repo_dir))
+        if (version_remote <= readPackagesDbVersion(db_repo_dir))
+        {
+            LOG_DEBUG(logger, "Checking remote version");
+            run_background([remote_version_file](const auto &cancel)
+            {
+                HttpRequest req = httpSettings;
+                req.url = db_version_url;
+                req.connect_timeout = 2;
+                req.timeout = 3;
+                auto resp = getHttpSession().request(req, &cancel);
+                if (resp.http_code != 200)
+                    return;
+                write_file(remote_version_file, std::to_string(std::stoi(resp.response)));
+            });
+        }
+        else
         {
             // multiprocess aware
             single_process_job(get_lock("db_update"), [this]
@@ -926,7 +1248,7 @@ void PackagesDatabase::download()
     {
         fs::create_directories(db_repo_dir);
         auto fn = get_temp_filename();
-        download_file(db_master_url, fn, 1_GB);
+        download_file_resumable(db_master_url, fn, 1_GB);
         auto unpack_dir = get_temp_filename();
         auto files = unpack_file(fn, unpack_dir);
         for (auto &f : files)
@@ -982,6 +1304,21 @@ void PackagesDatabase::download()
     writeDownloadTime();
 }
 
+static std::set<String> get_trigrams(String s)
+{
+    boost::to_lower(s);
+    std::set<String> trigrams;
+    for (size_t i = 0; i + 3 <= s.size(); i++)
+        trigrams.insert(s.substr(i, 3));
+    return trigrams;
+}
+
+static String escape_sql_string(String s)
+{
+    boost::replace_all(s, "'", "''");
+    return s;
+}
+
 void PackagesDatabase::load(bool drop)
 {
     auto &sdb = getServiceDatabase();
@@ -1054,6 +1391,35 @@ void PackagesDatabase::load(bool drop)
             throw std::runtime_error("sqlite3_finalize() failed");
     }
 
+    // search index, it is not a part of remote data
+    db->execute(R"(
+        CREATE TABLE IF NOT EXISTS "ProjectTrigrams" (
+            "trigram" TEXT NOT NULL,
+            "project_id" INTEGER NOT NULL,
+            PRIMARY KEY ("trigram", "project_id")
+        ) WITHOUT ROWID;
+        delete from ProjectTrigrams;
+    )");
+    {
+        String query = "insert or ignore into ProjectTrigrams values (?, ?);";
+        if (sqlite3_prepare_v2(mdb, query.c_str(), (int)query.size() + 1, &stmt, 0) != SQLITE_OK)
+            throw std::runtime_error(sqlite3_errmsg(mdb));
+        db->execute("select id, path from Projects", [stmt](SQLITE_CALLBACK_ARGS)
+        {
+            for (auto &t : get_trigrams(cols[1]))
+            {
+                sqlite3_bind_text(stmt, 1, t.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_text(stmt, 2, cols[0], -1, SQLITE_TRANSIENT);
+                // abort the query on error
+                if (sqlite3_step(stmt) != SQLITE_DONE || sqlite3_reset(stmt) != SQLITE_OK)
+                    return 1;
+            }
+            return 0;
+        });
+        if (sqlite3_finalize(stmt) != SQLITE_OK)
+            throw std::runtime_error("sqlite3_finalize() failed");
+    }
+
     db->execute("COMMIT;");
 
     db->execute("PRAGMA foreign_keys = ON;");
@@ -1351,9 +1717,9 @@ PackagesDatabase::Dependencies PackagesDatabase::getProjectDependencies(ProjectV
     return dependencies;
 }
 
-void PackagesDatabase::listPackages(const String &name) const
+void PackagesDatabase::listPackages(const String &name, int limit, int offset) const
 {
-    auto pkgs = getMatchingPackages<std::set>(name);
+    auto pkgs = searchPackages(name, limit, offset);
     if (pkgs.empty())
     {
         LOG_INFO(logger, "nothing found");
@@ -1362,17 +1728,112 @@ void PackagesDatabase::listPackages(const String &name) const
 
     for (auto &pkg : pkgs)
     {
-        auto versions = getVersionsForPackage(pkg);
-        String out = pkg.toString();
-        out += " (";
-        for (auto &v : versions)
-            out += v.toString() + ", ";
-        out.resize(out.size() - 2);
-        out += ")";
+        String out = pkg.ppath.toString();
+        if (!pkg.versions.empty())
+        {
+            out += " (";
+            for (auto &v : pkg.versions)
+                out += v.toString() + ", ";
+            out.resize(out.size() - 2);
+            out += ")";
+        }
         LOG_INFO(logger, out);
     }
 }
 
+std::vector<PackageSearchResult> PackagesDatabase::searchPackages(const String &name, int limit, int offset) const
+{
+    struct Candidate
+    {
+        PackageSearchResult r;
+        String id;
+    };
+    std::vector<Candidate> candidates;
+
+    auto lname = boost::to_lower_copy(name);
+    auto trigrams = get_trigrams(lname);
+    auto add_candidate = [&candidates, &lname, &trigrams](SQLITE_CALLBACK_ARGS)
+    {
+        Candidate c;
+        c.id = cols[0];
+        c.r.ppath = String(cols[1]);
+        auto p = boost::to_lower_copy(c.r.ppath.toString());
+        if (lname.empty() || p.find(lname) != p.npos)
+            c.r.score = 1;
+        else
+            c.r.score = trigrams.empty() ? 0 : std::stod(cols[2]) / trigrams.size() / 2;
+        candidates.push_back(c);
+        return 0;
+    };
+
+    // old dbs have no index, short names have no trigrams
+    if (trigrams.empty() || db->getNumberOfColumns("ProjectTrigrams") == 0)
+    {
+        // user input must not act as wildcards
+        String pattern;
+        for (auto c : name)
+        {
+            if (c == '%' || c == '_' || c == '\\')
+                pattern += '\\';
+            pattern += c;
+        }
+        db->execute("select id, path, 0 from Projects where type_id <> '3' and path like '%" + escape_sql_string(pattern) + "%' escape '\\'", add_candidate);
+    }
+    else
+    {
+        // at least a half of trigrams must match
+        String in;
+        for (auto &t : trigrams)
+            in += "'" + escape_sql_string(t) + "', ";
+        in.resize(in.size() - 2);
+        db->execute(
+            "select Projects.id, path, hits from "
+            "(select project_id, count(*) as hits from ProjectTrigrams where trigram in (" + in + ") group by project_id "
+            "having hits * 2 >= " + std::to_string(trigrams.size()) + ") "
+            "join Projects on Projects.id = project_id where type_id <> '3'",
+            add_candidate);
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](const auto &c1, const auto &c2)
+    {
+        if (c1.r.score != c2.r.score)
+            return c1.r.score > c2.r.score;
+        return c1.r.ppath.toString() < c2.r.ppath.toString();
+    });
+
+    // paging
+    if (offset > 0)
+        candidates.erase(candidates.begin(), candidates.begin() + std::min<size_t>(offset, candidates.size()));
+    if (limit > 0 && candidates.size() > (size_t)limit)
+        candidates.resize(limit);
+    if (candidates.empty())
+        return {};
+
+    // versions of the whole page in one query
+    std::unordered_map<String, size_t> idx;
+    String ids;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        idx[candidates[i].id] = i;
+        ids += "'" + candidates[i].id + "', ";
+    }
+    ids.resize(ids.size() - 2);
+    db->execute(
+        "select project_id, case when branch is not null then branch else major || '.' || minor || '.' || patch end as version "
+        "from ProjectVersions where project_id in (" + ids + ") order by branch, major, minor, patch",
+        [&candidates, &idx](SQLITE_CALLBACK_ARGS)
+    {
+        candidates[idx[cols[0]]].r.versions.push_back(String(cols[1]));
+        return 0;
+    });
+
+    std::vector<PackageSearchResult> r;
+    r.reserve(candidates.size());
+    for (auto &c : candidates)
+        r.push_back(std::move(c.r));
+    return r;
+}
+
 Version PackagesDatabase::getExactVersionForPackage(const Package &p) const
 {
     DownloadDependency d;
@@ -1391,10 +1852,24 @@ C<ProjectPath> PackagesDatabase::getMatchingPackages(const String &name) const
 {
     C<ProjectPath> pkgs;
     String q;
+    auto trigrams = get_trigrams(name);
     if (name.empty())
         q = "select path from Projects where type_id <> '3' order by path";
+    else if (trigrams.empty() || db->getNumberOfColumns("ProjectTrigrams") == 0)
+        q = "select path from Projects where type_id <> '3' and path like '%" + escape_sql_string(name) + "%' order by path";
     else
-        q = "select path from Projects where type_id <> '3' and path like '%" + name + "%' order by path";
+    {
+        // all trigrams must be present, then check the substring
+        String in;
+        for (auto &t : trigrams)
+            in += "'" + escape_sql_string(t) + "', ";
+        in.resize(in.size() - 2);
+        q = "select path from "
+            "(select project_id from ProjectTrigrams where trigram in (" + in + ") group by project_id "
+            "having count(*) = " + std::to_string(trigrams.size()) + ") "
+            "join Projects on Projects.id = project_id "
+            "where type_id <> '3' and path like '%" + escape_sql_string(name) + "%' order by path";
+    }
     db->execute(q, [&pkgs](SQLITE_CALLBACK_ARGS)
     {
         pkgs.insert(String(cols[0]));
@@ -1434,38 +1909,49 @@ ProjectId PackagesDatabase::getPackageId(const ProjectPath &ppath) const
     return id;
 }
 
-PackagesSet PackagesDatabase::getDependentPackages(const Package &pkg)
+const PackagesDatabase::ReverseDependencies &PackagesDatabase::getReverseDependencies()
 {
-    PackagesSet r;
-
-    // 1. Find current project version id.
-    ProjectId project_id = getPackageId(pkg.ppath);
+    if (reverse_dependencies)
+        return *reverse_dependencies;
 
-    // 2. Find project versions dependent on this version.
-    // Probably set to ProjectVersionId, String, String to prevent throwing exceptions, but left as is for now.
-    std::set<std::tuple<Version, String, String>> pkgs_s;
+    // whole index is built with one query
+    reverse_dependencies = std::make_unique<ReverseDependencies>();
+    auto &rdeps = *reverse_dependencies;
     db->execute(
-        R"(select version, path,
+        R"(select Dependencies.path, ProjectVersionDependencies.version, Projects.path,
         case when branch is not null then branch else major || '.' || minor || '.' || patch end as version2
         from ProjectVersionDependencies
         join ProjectVersions on ProjectVersions.id = project_version_id
-        join Projects on Projects.id = project_id
-        where project_dependency_id = ')" + std::to_string(project_id) + "'",
-        [&pkgs_s](SQLITE_CALLBACK_ARGS)
+        join Projects on Projects.id = ProjectVersions.project_id
+        join Projects as Dependencies on Dependencies.id = project_dependency_id)",
+        [&rdeps](SQLITE_CALLBACK_ARGS)
     {
-        pkgs_s.emplace(cols[0], cols[1], cols[2]);
+        ReverseDependency r;
+        r.version = String(cols[1]);
+        r.dependent.ppath = String(cols[2]);
+        r.dependent.version = String(cols[3]);
+        rdeps[String(cols[0])].push_back(r);
         return 0;
     });
+    return rdeps;
+}
 
-    // 3. Match versions.
-    for (auto &p : pkgs_s)
+PackagesSet PackagesDatabase::getDependentPackages(const Package &pkg)
+{
+    PackagesSet r;
+
+    auto &rdeps = getReverseDependencies();
+    auto i = rdeps.find(pkg.ppath);
+    if (i == rdeps.end())
+        return r;
+
+    // match versions
+    for (auto &rdep : i->second)
     {
-        auto &v = std::get<0>(p);
+        auto &v = rdep.version;
         if (v == pkg.version || v.canBe(pkg.version))
         {
-            Package d;
-            d.ppath = std::get<1>(p);
-            d.version = std::get<2>(p);
+            auto d = rdep.dependent;
             d.createNames();
             r.insert(d);
         }
@@ -1492,41 +1978,18 @@ PackagesSet PackagesDatabase::getDependentPackages(const PackagesSet &pkgs)
 
 PackagesSet PackagesDatabase::getTransitiveDependentPackages(const PackagesSet &pkgs)
 {
-    using Retrieved = std::unordered_map<Package, PackagesSet>;
-
-    static std::shared_mutex m;
-    static Retrieved retrieved;
-
+    // bfs over reverse dependencies
     auto r = pkgs;
-    while (1)
+    std::deque<Package> q(pkgs.begin(), pkgs.end());
+    while (!q.empty())
     {
-        bool changed = false;
-
-        for (auto &pkg : r)
+        auto pkg = q.front();
+        q.pop_front();
+        for (auto &d : getDependentPackages(pkg))
         {
-            {
-                std::shared_lock<std::shared_mutex> lk(m);
-                auto i = retrieved.find(pkg);
-                if (i != retrieved.end())
-                {
-                    r.insert(i->second.begin(), i->second.end());
-                    continue;
-                }
-            }
-
-            changed = true;
-
-            auto dpkgs = getDependentPackages(pkg);
-            r.insert(dpkgs.begin(), dpkgs.end());
-            {
-                std::unique_lock<std::shared_mutex> lk(m);
-                retrieved[pkg] = dpkgs;
-            }
-            break;
+            if (r.insert(d).second)
+                q.push_back(d);
         }
-
-        if (!changed)
-            break;
     }
 
     // exclude input
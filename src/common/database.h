@@ -24,6 +24,7 @@
 
 #include <chrono>
 #include <memory>
+#include <set>
 #include <vector>
 
 class SqliteDatabase;
@@ -77,6 +78,26 @@ protected:
     void recreate();
 };
 
+struct RemoteHealth
+{
+    int latency = 0; // ms, smoothed
+    int failures = 0; // in a row
+    TimePoint last_failure;
+};
+
+// by remote url
+using RemotesHealth = std::unordered_map<String, RemoteHealth>;
+
+struct DownloadSourceStats
+{
+    int64_t throughput = 0; // bytes per second, smoothed
+    int failures = 0; // in a row
+    TimePoint last_failure;
+};
+
+// by host
+using DownloadSourcesStats = std::unordered_map<String, DownloadSourceStats>;
+
 class ServiceDatabase : public Database
 {
 public:
@@ -84,7 +105,8 @@ public:
 
     void init();
 
-    void performStartupActions() const;
+    // returns false when some action failed
+    bool performStartupActions() const;
 
     void checkForUpdates() const;
     TimePoint getLastClientUpdateCheck() const;
@@ -97,12 +119,26 @@ public:
     void setPackagesDbSchemaVersion(int version) const;
 
     bool isActionPerformed(const StartupAction &action) const;
+    std::set<std::pair<int, int>> getPerformedActions() const;
     void setActionPerformed(const StartupAction &action) const;
 
     String getConfigByHash(const String &settings_hash) const;
     void addConfigHash(const String &settings_hash, const String &config, const String &config_hash) const;
     void clearConfigHashes() const;
     void removeConfigHashes(const String &config_hash) const;
+    void setConfigLastUse(const String &config_hash, const TimePoint &p = Clock::now()) const;
+    std::unordered_map<String, TimePoint> getConfigsLastUse() const;
+
+    // package hash -> (archive hash, summary)
+    using ConfigSummaries = std::unordered_map<String, std::pair<String, String>>;
+    ConfigSummaries getConfigSummaries() const;
+    void setConfigSummaries(const ConfigSummaries &summaries) const;
+
+    RemotesHealth getRemotesHealth() const;
+    void setRemoteHealth(const String &url, const RemoteHealth &h) const;
+
+    DownloadSourcesStats getDownloadSourcesStats() const;
+    void setDownloadSourceStats(const String &host, const DownloadSourceStats &s) const;
 
     void setPackageDependenciesHash(const Package &p, const String &hash) const;
     bool hasPackageDependenciesHash(const Package &p, const String &hash) const;
@@ -112,6 +148,10 @@ public:
     String getInstalledPackageHash(const Package &p) const;
     int getInstalledPackageId(const Package &p) const;
     PackagesSet getInstalledPackages() const;
+    void setPackagesLastUse(const PackagesSet &pkgs, const TimePoint &p = Clock::now()) const;
+    std::unordered_map<Package, TimePoint> getPackagesLastUse() const;
+    // removes packages with their source groups and sets dependencies hashes in one transaction
+    void updateCleanedPackages(const PackagesSet &removed, const std::unordered_map<Package, String> &dependencies_hashes) const;
 
     void setSourceGroups(const Package &p, const SourceGroups &sg) const;
     SourceGroups getSourceGroups(const Package &p) const;
@@ -127,23 +167,48 @@ private:
     void createTables() const;
     void checkStamp() const;
 
+    // combined version of schema, stamp and startup actions,
+    // stored in PRAGMA user_version
+    int getStartupVersion() const;
+    int getUserVersion() const;
+    void checkVersion() const;
+
     String getTableHash(const String &table) const;
+    std::unordered_map<String, String> getTableHashes() const;
     void setTableHash(const String &table, const String &hash) const;
 
     void recreateTable(const TableDescriptor &td) const;
 };
 
+struct PackageSearchResult
+{
+    ProjectPath ppath;
+    std::vector<Version> versions;
+    // 1 for substring matches, less for fuzzy ones
+    double score = 0;
+};
+
 class PackagesDatabase : public Database
 {
     using Dependencies = DownloadDependency::DbDependencies;
     using DependenciesMap = std::unordered_map<Package, DownloadDependency>;
 
+    struct ReverseDependency
+    {
+        Version version; // version of dependency as written in dependent package
+        Package dependent;
+    };
+    // dependency -> packages that depend on it
+    using ReverseDependencies = std::unordered_map<ProjectPath, std::vector<ReverseDependency>>;
+
 public:
     PackagesDatabase();
 
     IdDependencies findDependencies(const Packages &deps) const;
 
-    void listPackages(const String &name = String()) const;
+    void listPackages(const String &name = String(), int limit = 0, int offset = 0) const;
+    // ranked fuzzy search, limit = 0 means no limit
+    std::vector<PackageSearchResult> searchPackages(const String &name, int limit = 0, int offset = 0) const;
 
     template <template <class...> class C>
     C<ProjectPath> getMatchingPackages(const String &name = String()) const;
@@ -158,6 +223,7 @@ public:
 
 private:
     path db_repo_dir;
+    std::unique_ptr<ReverseDependencies> reverse_dependencies;
 
     void init();
     void download();
@@ -170,6 +236,7 @@ private:
 
     ProjectVersionId getExactProjectVersionId(const DownloadDependency &project, Version &version, ProjectFlags &flags, String &hash) const;
     Dependencies getProjectDependencies(ProjectVersionId project_version_id, DependenciesMap &dm) const;
+    const ReverseDependencies &getReverseDependencies();
 };
 
 ServiceDatabase &getServiceDatabase(bool init = true);
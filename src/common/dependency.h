@@ -42,6 +42,7 @@ struct DownloadDependency : ExtendedPackageData
     Dependencies dependencies;
 
     void setDependencyIds(const std::unordered_set<ProjectVersionId> &ids);
+    const std::unordered_set<ProjectVersionId> &getDependencyIds() const { return id_dependencies; }
     void prepareDependencies(const IdDependencies &dd);
 
 private:
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "download.h"
+
+#include "http_session.h"
+
+#include <boost/nowide/fstream.hpp>
+#include <primitives/executor.h>
+#include <primitives/templates.h>
+
+#include <algorithm>
+#include <thread>
+
+#include <primitives/log.h>
+//DECLARE_STATIC_LOGGER(logger, "download");
+
+#define DOWNLOAD_N_TRIES 5
+#define DOWNLOAD_CHUNKED_MIN_SIZE (32 * 1024 * 1024)
+#define DOWNLOAD_CHUNK_SIZE (16 * 1024 * 1024)
+#define DOWNLOAD_MAX_CHUNKS 4
+
+static bool is_retriable(long http_code)
+{
+    return http_code == 0 || http_code == 429 || http_code >= 500;
+}
+
+static uintmax_t get_size(const path &fn)
+{
+    boost::system::error_code ec;
+    auto sz = fs::file_size(fn, ec);
+    return ec ? 0 : sz;
+}
+
+// returns false when file is large and server accepts ranges,
+// so it can be downloaded in chunks (info is set)
+static bool download_single(const HttpRequest &req, const path &part, uintmax_t file_size_limit,
+    bool try_ranges, HttpFileInfo &info)
+{
+    // validator of the partial file, without it we cannot continue on the next run
+    auto vfn = path(part) += ".validator";
+
+    auto &session = getHttpSession();
+    HttpDownload opts;
+    opts.file_size_limit = file_size_limit;
+    for (int i = 0; i < DOWNLOAD_N_TRIES; i++)
+    {
+        if (i)
+            std::this_thread::sleep_for(get_backoff_delay(i - 1));
+
+        opts.offset = get_size(part);
+        if (i == 0)
+        {
+            opts.validator = fs::exists(vfn) ? read_file(vfn) : String();
+            if (opts.validator.empty())
+                opts.offset = 0;
+        }
+        // size is known from the first response, no separate HEAD request
+        opts.ranges_min_size = try_ranges && i == 0 && opts.offset == 0 ? DOWNLOAD_CHUNKED_MIN_SIZE : 0;
+
+        auto r = session.download(req, part, opts);
+        if (r.large)
+        {
+            info = r;
+            return false;
+        }
+        if (r.size_limit_exceeded)
+        {
+            fs::remove(part);
+            fs::remove(vfn);
+            throw std::runtime_error("File is too big: " + req.url);
+        }
+        if (r.http_code == 0 && !r.validator.empty() && r.validator != opts.validator)
+        {
+            opts.validator = r.validator;
+            write_file(vfn, r.validator);
+        }
+        if (r.http_code == 200 || r.http_code == 206)
+        {
+            fs::remove(vfn);
+            return true;
+        }
+        if (r.http_code == 416)
+        {
+            // partial file is broken
+            fs::remove(part);
+            continue;
+        }
+        if (!is_retriable(r.http_code))
+        {
+            fs::remove(part);
+            fs::remove(vfn);
+            throw HttpError("Cannot download " + req.url + ": http code " + std::to_string(r.http_code), r.http_code);
+        }
+        if (r.http_code == 0)
+            LOG_DEBUG(logger, "Download of " << req.url << " is interrupted at " << get_size(part) << " bytes");
+    }
+    throw std::runtime_error("Cannot download " + req.url + ": too many tries");
+}
+
+static void download_chunk(const HttpRequest &req, const path &fn, uintmax_t first, uintmax_t last, const String &validator)
+{
+    auto &session = getHttpSession();
+    auto size = last - first + 1;
+    HttpDownload opts;
+    opts.last = last;
+    opts.validator = validator;
+    for (int i = 0; i < DOWNLOAD_N_TRIES; i++)
+    {
+        if (i)
+            std::this_thread::sleep_for(get_backoff_delay(i - 1));
+
+        // chunk verification: more data than requested means broken transfer
+        auto have = get_size(fn);
+        if (have > size)
+        {
+            fs::remove(fn);
+            have = 0;
+        }
+        if (have == size)
+            return;
+
+        opts.offset = first + have;
+        auto r = session.download(req, fn, opts);
+        if (r.http_code == 200)
+            throw std::runtime_error("Server does not support ranges or file was changed");
+        if (r.http_code != 206 && !is_retriable(r.http_code))
+            throw std::runtime_error("Cannot download " + req.url + ": http code " + std::to_string(r.http_code));
+    }
+    if (get_size(fn) != size)
+        throw std::runtime_error("Cannot download " + req.url + ": too many tries");
+}
+
+static void download_chunks(const HttpRequest &req, const path &part, uintmax_t size, const String &validator)
+{
+    auto n = (int)std::min<uintmax_t>(DOWNLOAD_MAX_CHUNKS, (size + DOWNLOAD_CHUNK_SIZE - 1) / DOWNLOAD_CHUNK_SIZE);
+    auto chunk_size = (size + n - 1) / n;
+
+    std::vector<path> chunks;
+    for (int i = 0; i < n; i++)
+        chunks.push_back(path(part) += "." + std::to_string(i));
+
+    SCOPE_EXIT
+    {
+        boost::system::error_code ec;
+        for (auto &c : chunks)
+            fs::remove(c, ec);
+    };
+
+    Executor e(n, "Downloader");
+    std::vector<Future<void>> fs;
+    for (int i = 0; i < n; i++)
+    {
+        auto first = i * chunk_size;
+        auto last = std::min(size, first + chunk_size) - 1;
+        fs.push_back(e.push([&req, &chunks, &validator, i, first, last]
+        {
+            download_chunk(req, chunks[i], first, last, validator);
+        }));
+    }
+    for (auto &f : fs)
+        f.wait();
+    for (auto &f : fs)
+        f.get();
+
+    boost::nowide::ofstream o(part.string(), std::ios::binary | std::ios::out);
+    if (!o)
+        throw std::runtime_error("Cannot open file: " + part.string());
+    for (auto &c : chunks)
+    {
+        boost::nowide::ifstream i(c.string(), std::ios::binary | std::ios::in);
+        o << i.rdbuf();
+    }
+    o.close();
+    if (get_size(part) != size)
+    {
+        fs::remove(part);
+        throw std::runtime_error("Cannot download " + req.url + ": size mismatch");
+    }
+}
+
+void download_file_resumable(const String &url, const path &fn, uintmax_t file_size_limit)
+{
+    HttpRequest req = httpSettings;
+    req.url = url;
+
+    auto part = path(fn) += ".part";
+
+    HttpFileInfo info;
+    if (!download_single(req, part, file_size_limit, !fs::exists(part), info))
+    {
+        try
+        {
+            download_chunks(req, part, info.size, info.validator);
+        }
+        catch (std::exception &e)
+        {
+            LOG_DEBUG(logger, "Parallel download failed: " << e.what());
+            download_single(req, part, file_size_limit, false, info);
+        }
+    }
+
+    boost::system::error_code ec;
+    fs::remove(fn, ec);
+    fs::rename(part, fn);
+}
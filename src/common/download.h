@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <primitives/filesystem.h>
+
+#include <stdexcept>
+
+// server answered with non retriable http code
+struct HttpError : public std::runtime_error
+{
+    long http_code;
+
+    HttpError(const String &msg, long http_code)
+        : std::runtime_error(msg), http_code(http_code)
+    {
+    }
+};
+
+// Downloads file through fn.part, so interrupted transfer
+// is continued on the next try or even on the next run.
+// Large files are fetched with several range requests in parallel,
+// when server supports them.
+void download_file_resumable(const String &url, const path &fn, uintmax_t file_size_limit = 0);
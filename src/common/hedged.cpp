@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "hedged.h"
+
+#include <primitives/executor.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <primitives/log.h>
+//DECLARE_STATIC_LOGGER(logger, "hedged");
+
+int hedged_race(size_t n, const HedgeDelay &delay, const HedgedTask &task, const HedgeStalled &stalled)
+{
+    if (n == 0)
+        return -1;
+
+    // tasks may come from executor threads, so they have own pool
+    static Executor e(get_max_threads(16), "Hedged");
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::atomic_bool cancel{ false };
+    size_t n_failed = 0;
+    bool abort = false;
+    int winner = -1;
+    std::vector<Future<void>> fs;
+
+    auto launch = [&]
+    {
+        auto i = fs.size();
+        fs.push_back(e.push([&, i]
+        {
+            auto r = HedgeResult::Failure;
+            try
+            {
+                r = task(i, cancel);
+            }
+            catch (std::exception &ex)
+            {
+                LOG_DEBUG(logger, "hedged task failed: " << ex.what());
+            }
+
+            std::unique_lock<std::mutex> lk(m);
+            switch (r)
+            {
+            case HedgeResult::Success:
+                if (winner == -1)
+                    winner = (int)i;
+                break;
+            case HedgeResult::Abort:
+                abort = true;
+                // fallthrough
+            default:
+                n_failed++;
+                break;
+            }
+            cv.notify_all();
+        }));
+    };
+
+    auto done = [&] { return winner != -1 || abort; };
+
+    std::unique_lock<std::mutex> lk(m);
+    launch();
+    while (!done())
+    {
+        if (fs.size() == n)
+        {
+            cv.wait(lk, [&] { return done() || n_failed == fs.size(); });
+            break;
+        }
+        if (n_failed != fs.size())
+        {
+            // wait for an answer or a failure, then start the next task
+            auto failed = n_failed;
+            cv.wait_for(lk, delay(fs.size() - 1), [&] { return done() || n_failed != failed; });
+            if (done())
+                break;
+            // still making progress
+            if (n_failed == failed && stalled && !stalled(fs.size() - 1))
+                continue;
+        }
+        launch();
+    }
+    cancel = true;
+    lk.unlock();
+
+    for (auto &f : fs)
+        f.wait();
+    return winner;
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+enum class HedgeResult
+{
+    Failure,
+    Success,
+    Abort, // stop the race without a winner
+};
+
+using HedgedTask = std::function<HedgeResult(size_t i, const std::atomic_bool &cancel)>;
+using HedgeDelay = std::function<std::chrono::milliseconds(size_t i)>;
+using HedgeStalled = std::function<bool(size_t i)>;
+
+// Starts tasks one by one. The next task is started when the previous
+// ones do not finish in delay(i) or when one of them fails.
+// With stalled set, it is checked every delay(i) and the next task
+// is started only when it returns true for the last started one.
+// When a task succeeds, others get cancel flag set.
+// Returns index of the winner or -1.
+// All tasks are finished on return.
+int hedged_race(size_t n, const HedgeDelay &delay, const HedgedTask &task,
+    const HedgeStalled &stalled = HedgeStalled());
@@ -24,13 +24,102 @@
 
 #include <boost/algorithm/string.hpp>
 #include <boost/nowide/fstream.hpp>
+#include <primitives/executor.h>
 
+#include <atomic>
+#include <chrono>
+#include <iomanip>
 #include <regex>
 #include <shared_mutex>
 
 #include <primitives/log.h>
 //DECLARE_STATIC_LOGGER(logger, "package");
 
+namespace
+{
+
+// names and hashes derived from package identity (ppath and version)
+struct PackageNames
+{
+    String hash;
+    String hash_short;
+    path hash_path;
+    String target_name;
+    String variable_name;
+    String variable_no_version_name;
+
+    PackageNames(const Package &p)
+    {
+        static const auto delim = "/";
+        hash = sha256_counted(p.ppath.toString() + delim + p.version.toString());
+        hash_short = shorten_hash(hash);
+
+        hash_path /= hash_short.substr(0, 2);
+        hash_path /= hash_short.substr(2, 2);
+        hash_path /= hash_short.substr(4);
+
+        auto v = p.version.toAnyVersion();
+
+        target_name = p.ppath.toString() + (v == "*" ? "" : ("-" + v));
+
+        // for local projects we use simplified variable name without
+        // the second dir hash argument
+        auto vname = p.ppath.toString();
+        if (p.ppath.is_loc())
+            vname = p.ppath[PathElementType::Namespace] / p.ppath[PathElementType::Tail];
+
+        variable_name = vname + (v == "*" ? "" : ("_" + v));
+        std::replace(variable_name.begin(), variable_name.end(), '.', '_');
+
+        variable_no_version_name = vname;
+        std::replace(variable_no_version_name.begin(), variable_no_version_name.end(), '.', '_');
+    }
+};
+
+// full identity: Version::operator== ignores version type,
+// but names depend on it ("=" and "*" versions)
+struct PackageNamesKey
+{
+    ProjectPath ppath;
+    Version version;
+
+    bool operator==(const PackageNamesKey &rhs) const
+    {
+        return ppath == rhs.ppath && version == rhs.version &&
+            version.type == rhs.version.type;
+    }
+};
+
+struct PackageNamesKeyHash
+{
+    size_t operator()(const PackageNamesKey &k) const
+    {
+        auto h = std::hash<ProjectPath>()(k.ppath);
+        hash_combine(h, std::hash<Version>()(k.version));
+        return hash_combine(h, (int)k.version.type);
+    }
+};
+
+// process-wide memo, entries are never removed, so references are stable
+const PackageNames &getPackageNames(const Package &p)
+{
+    static std::unordered_map<PackageNamesKey, PackageNames, PackageNamesKeyHash> names;
+    static std::shared_mutex m;
+
+    PackageNamesKey k{ p.ppath, p.version };
+    {
+        std::shared_lock<std::shared_mutex> lk(m);
+        auto i = names.find(k);
+        if (i != names.end())
+            return i->second;
+    }
+    PackageNames n(p);
+    std::unique_lock<std::shared_mutex> lk(m);
+    return names.emplace(k, std::move(n)).first->second;
+}
+
+}
+
 path Package::getDir(const path &p) const
 {
     return p / getHashPath();
@@ -55,6 +144,14 @@ path Package::getStampFilename() const
     return b;
 }
 
+path Package::getConfigCacheFilename() const
+{
+    // binary form of cppan.yml, next to the stamp
+    auto f = getStampFilename();
+    f.replace_extension(".config");
+    return f;
+}
+
 String Package::getStampHash() const
 {
     String hash;
@@ -66,15 +163,12 @@ String Package::getStampHash() const
 
 String Package::getHash() const
 {
-    static const auto delim = "/";
-    if (hash.empty())
-        return sha256(ppath.toString() + delim + version.toString());
-    return hash;
+    return getPackageNames(*this).hash;
 }
 
 String Package::getHashShort() const
 {
-    return shorten_hash(getHash());
+    return getPackageNames(*this).hash_short;
 }
 
 String Package::getFilesystemHash() const
@@ -84,34 +178,16 @@ String Package::getFilesystemHash() const
 
 path Package::getHashPath() const
 {
-    auto h = getFilesystemHash();
-    path p;
-    p /= h.substr(0, 2);
-    p /= h.substr(2, 2);
-    p /= h.substr(4);
-    return p;
+    return getPackageNames(*this).hash_path;
 }
 
 void Package::createNames()
 {
-    auto v = version.toAnyVersion();
-
-    target_name = ppath.toString() + (v == "*" ? "" : ("-" + v));
-
-    // for local projects we use simplified variable name without
-    // the second dir hash argument
-    auto vname = ppath.toString();
-    if (ppath.is_loc())
-        vname = ppath[PathElementType::Namespace] / ppath[PathElementType::Tail];
-
-    variable_name = vname + (v == "*" ? "" : ("_" + v));
-    std::replace(variable_name.begin(), variable_name.end(), '.', '_');
-
-    variable_no_version_name = vname;
-    std::replace(variable_no_version_name.begin(), variable_no_version_name.end(), '.', '_');
-
-    target_name_hash = getHashShort();
-    hash = getHash();
+    auto &names = getPackageNames(*this);
+    target_name = names.target_name;
+    variable_name = names.variable_name;
+    variable_no_version_name = names.variable_no_version_name;
+    target_name_hash = names.hash_short;
 }
 
 String Package::getTargetName() const
@@ -183,7 +259,8 @@ void cleanPackages(const String &s, int flags)
     if (pkgs.empty())
         return;
 
-    cleanPackages(pkgs, flags);
+    CleanPlan plan;
+    plan.add(pkgs, flags);
 
     if (flags & CleanTarget::Src)
     {
@@ -194,24 +271,49 @@ void cleanPackages(const String &s, int flags)
                 CleanTarget::Exp ;
     }
 
-    // find dependent packages and remove non installed
-    auto dpkgs = getPackagesDatabase().getTransitiveDependentPackages(pkgs);
-    for (auto i = dpkgs.begin(); i != dpkgs.end();)
-    {
-        if (ipkgs.find(*i) == ipkgs.end())
-            i = dpkgs.erase(i);
-        else
-            ++i;
-    }
+    plan.addDependents(pkgs, flags);
+    plan.execute();
+}
 
-    cleanPackages(dpkgs, flags);
+void cleanPackages(const PackagesSet &pkgs, int flags)
+{
+    CleanPlan plan;
+    plan.add(pkgs, flags);
+    plan.execute();
 }
 
-void cleanPackage(const Package &pkg, int flags)
+const PackagesSet &CleanPlan::getInstalledPackages()
 {
-    static std::unordered_map<Package, int> cleaned_packages;
-    static std::shared_mutex m;
+    if (!installed_packages)
+        installed_packages = std::make_unique<PackagesSet>(getServiceDatabase().getInstalledPackages());
+    return *installed_packages;
+}
+
+void CleanPlan::add(const PackagesSet &pkgs, int flags)
+{
+    for (auto &pkg : pkgs)
+        add(pkg, flags);
+}
+
+void CleanPlan::addDependents(const PackagesSet &pkgs, int flags)
+{
+    if (pkgs.empty())
+        return;
+    // find dependent packages, non installed will be skipped in add()
+    add(getPackagesDatabase().getTransitiveDependentPackages(pkgs), flags);
+}
+
+void CleanPlan::setDependenciesHash(const Package &pkg, const String &hash)
+{
+    dependencies_hashes[pkg] = hash;
+}
+
+// process wide, so we won't clean the same things twice
+static std::unordered_map<Package, int> cleaned_packages;
+static std::shared_mutex cleaned_packages_mutex;
 
+void CleanPlan::add(const Package &pkg, int flags)
+{
     static const auto cache_dir_bin = enumerate_files(directories.storage_dir_bin);
     static const auto cache_dir_exp = enumerate_files(directories.storage_dir_exp);
     static const auto cache_dir_lib = enumerate_files(directories.storage_dir_lib);
@@ -219,33 +321,25 @@ void cleanPackage(const Package &pkg, int flags)
     static const auto cache_dir_lnk = enumerate_files(directories.storage_dir_lnk);
 #endif
 
-    auto &sdb = getServiceDatabase();
-
     // Clean only installed packages.
-    if (sdb.getInstalledPackageId(pkg) == 0)
+    auto &ipkgs = getInstalledPackages();
+    if (ipkgs.find(pkg) == ipkgs.end())
         return;
 
     // only clean yet uncleaned flags
     {
-        std::shared_lock<std::shared_mutex> lock(m);
+        std::shared_lock<std::shared_mutex> lock(cleaned_packages_mutex);
         auto i = cleaned_packages.find(pkg);
         if (i != cleaned_packages.end())
             flags &= ~i->second;
-        if (flags == 0)
-            return;
     }
 
-    // save cleaned packages
-    {
-        std::unique_lock<std::shared_mutex> lock(m);
-        auto &f = cleaned_packages[pkg];
-        flags &= ~f;
-        f |= flags;
-
-        // double check, we have no upgrade lock
-        if (flags == 0)
-            return;
-    }
+    // packages are marked as cleaned only after execute()
+    auto &f = planned_flags[pkg];
+    flags &= ~f;
+    if (flags == 0)
+        return;
+    f |= flags;
 
     // log message
     {
@@ -266,58 +360,96 @@ void cleanPackage(const Package &pkg, int flags)
         LOG_INFO(logger, "Cleaning   : " + pkg.target_name + "..." + s);
     }
 
-    auto rm = [](const auto &p)
+    n_packages++;
+
+    auto add_files_like = [this, &pkg](const auto &files)
     {
-        if (fs::exists(p))
+        for (auto &f : files)
         {
-            boost::system::error_code ec;
-            fs::remove_all(p, ec);
+            if (f.filename().string().find(pkg.target_name) != String::npos)
+                paths.insert(f);
         }
     };
 
-    auto rm_recursive = [](const auto &pkg, const auto &files, const auto &ext)
+    auto add_files_named = [this](const auto &files, const auto &fn)
     {
-        boost::system::error_code ec;
         for (auto &f : files)
         {
-            auto fn = f.filename().string();
-            if (fn == pkg.target_name + ext)
-                fs::remove(f, ec);
+            if (f.filename().string() == fn)
+                paths.insert(f);
         }
     };
 
     if (flags & CleanTarget::Src)
-        rm(pkg.getDirSrc());
+        paths.insert(pkg.getDirSrc());
     if (flags & CleanTarget::Obj)
-        rm(pkg.getDirObj() / "build"); // for object targets we remove subdir
+        paths.insert(pkg.getDirObj() / "build"); // for object targets we remove subdir
 
     if (flags & CleanTarget::Bin)
-        remove_files_like(cache_dir_bin, ".*" + pkg.target_name + ".*");
+        add_files_like(cache_dir_bin);
     if (flags & CleanTarget::Lib)
-        remove_files_like(cache_dir_lib, ".*" + pkg.target_name + ".*");
+        add_files_like(cache_dir_lib);
 
     // cmake exports
     if (flags & CleanTarget::Exp)
-        rm_recursive(pkg, cache_dir_exp, ".cmake");
+        add_files_named(cache_dir_exp, pkg.target_name + ".cmake");
 
 #ifdef _WIN32
     // solution links
     if (flags & CleanTarget::Lnk)
-        rm_recursive(pkg, cache_dir_lnk, ".sln.lnk");
+        add_files_named(cache_dir_lnk, pkg.target_name + ".sln.lnk");
 #endif
 
     // remove packages at the end in case we're removing sources
     if (flags & CleanTarget::Src)
-    {
-        auto &sdb = getServiceDatabase();
-        sdb.removeInstalledPackage(pkg);
-    }
+        removed_packages.insert(pkg);
 }
 
-void cleanPackages(const PackagesSet &pkgs, int flags)
+void CleanPlan::execute()
 {
-    for (auto &pkg : pkgs)
-        cleanPackage(pkg, flags);
+    auto start = std::chrono::steady_clock::now();
+
+    std::atomic<uintmax_t> freed{ 0 };
+    auto rm = [&freed](const path &p)
+    {
+        boost::system::error_code ec;
+        if (!fs::exists(p, ec))
+            return;
+        auto sz = get_directory_size(p);
+        fs::remove_all(p, ec);
+        if (!ec)
+            freed += sz;
+    };
+
+    if (paths.size() > 1)
+    {
+        Executor e(std::min<size_t>(paths.size(), get_max_threads(8)), "Cleaner");
+        for (auto &p : paths)
+            e.push([&rm, &p] { rm(p); });
+        e.wait();
+    }
+    else
+    {
+        for (auto &p : paths)
+            rm(p);
+    }
+
+    // db changes go after files removal
+    getServiceDatabase().updateCleanedPackages(removed_packages, dependencies_hashes);
+
+    // failed plans are not marked, so packages are cleaned again on the next try
+    {
+        std::unique_lock<std::shared_mutex> lock(cleaned_packages_mutex);
+        for (auto &p : planned_flags)
+            cleaned_packages[p.first] |= p.second;
+    }
+
+    if (n_packages == 0)
+        return;
+
+    auto t = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO(logger, "Cleaned " << n_packages << " package(s), freed " <<
+        std::fixed << std::setprecision(1) << freed / double(1_MB) << " MB in " << t / 1000.0 << " s");
 }
 
 std::unordered_map<int, String> CleanTarget::getStringsById()
@@ -25,6 +25,8 @@
 #include <primitives/hash.h>
 
 #include <map>
+#include <memory>
+#include <set>
 
 struct Package
 {
@@ -44,6 +46,7 @@ struct Package
     String getFilesystemHash() const;
     path getHashPath() const;
     path getStampFilename() const;
+    path getConfigCacheFilename() const;
     String getStampHash() const;
 
     bool empty() const { return ppath.empty() || !version.isValid(); }
@@ -62,9 +65,6 @@ struct Package
     String getVariableName() const;
 
 private:
-    // cached vars
-    String hash;
-
     path getDir(const path &p) const;
 };
 
@@ -96,9 +96,6 @@ struct CleanTarget
     static std::unordered_map<int, String> getStringsById();
 };
 
-void cleanPackages(const String &s, int flags = CleanTarget::All);
-void cleanPackages(const PackagesSet &pkgs, int flags);
-
 namespace std
 {
 
@@ -112,3 +109,31 @@ template<> struct hash<Package>
 };
 
 }
+
+// Cleaning is done in two steps. At first we gather paths to remove
+// and service db changes, then paths are removed in parallel
+// and db is updated in a single transaction.
+class CleanPlan
+{
+public:
+    void add(const Package &pkg, int flags);
+    void add(const PackagesSet &pkgs, int flags);
+    // adds installed packages that depend on pkgs
+    void addDependents(const PackagesSet &pkgs, int flags);
+    void setDependenciesHash(const Package &pkg, const String &hash);
+
+    void execute();
+
+private:
+    std::set<path> paths;
+    PackagesSet removed_packages;
+    std::unordered_map<Package, String> dependencies_hashes;
+    std::unordered_map<Package, int> planned_flags;
+    std::unique_ptr<PackagesSet> installed_packages;
+    int n_packages = 0;
+
+    const PackagesSet &getInstalledPackages();
+};
+
+void cleanPackages(const String &s, int flags = CleanTarget::All);
+void cleanPackages(const PackagesSet &pkgs, int flags);
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "database.h"
 #include "directories.h"
+#include "download.h"
 #include "exceptions.h"
 #include "hash.h"
 #include "lock.h"
@@ -44,6 +45,69 @@ PackageStore rd;
 
 Strings extract_comments(const String &s);
 
+LazyConfig &LazyConfig::operator=(Config *c)
+{
+    std::unique_lock<std::mutex> lk(*m);
+    config = c;
+    loader = nullptr;
+    summary.reset();
+    return *this;
+}
+
+Config *LazyConfig::load() const
+{
+    if (!config && loader)
+    {
+        config = loader();
+        loader = nullptr;
+    }
+    return config;
+}
+
+Config *LazyConfig::get() const
+{
+    std::unique_lock<std::mutex> lk(*m);
+    return load();
+}
+
+void LazyConfig::setLoader(const ConfigSummary &s, Loader l)
+{
+    std::unique_lock<std::mutex> lk(*m);
+    config = nullptr;
+    loader = l;
+    summary = std::make_unique<ConfigSummary>(s);
+}
+
+ConfigSummary &LazyConfig::summarize() const
+{
+    if (!summary)
+    {
+        auto c = load();
+        if (!c)
+            throw std::logic_error("Config is not set");
+        summary = std::make_unique<ConfigSummary>(*c, c->pkg);
+    }
+    return *summary;
+}
+
+const ConfigSummary &LazyConfig::getSummary() const
+{
+    std::unique_lock<std::mutex> lk(*m);
+    return summarize();
+}
+
+ConfigSummary &LazyConfig::getSummary()
+{
+    std::unique_lock<std::mutex> lk(*m);
+    return summarize();
+}
+
+bool LazyConfig::loaded() const
+{
+    std::unique_lock<std::mutex> lk(*m);
+    return config != nullptr;
+}
+
 void download_file(path &fn)
 {
     // this function checks if fn is url,
@@ -52,7 +116,7 @@ void download_file(path &fn)
     if (!isUrl(s))
         return;
     fn = fn.filename();
-    download_file(s, fn, 1_GB);
+    download_file_resumable(s, fn, 1_GB);
 }
 
 void PackageStore::process(const path &p, Config &root)
@@ -64,8 +128,14 @@ void PackageStore::process(const path &p, Config &root)
     SCOPE_EXIT
     {
         processing = false;
+        lock_file.clear();
     };
 
+    // lock file is kept only near project configs
+    auto project_dir = p.empty() ? current_thread_path() : p;
+    if (fs::exists(project_dir / CPPAN_FILENAME))
+        lock_file = project_dir / CPPAN_LOCK_FILENAME;
+
     // main access table holder
     AccessTable access_table;
 
@@ -78,6 +148,10 @@ void PackageStore::process(const path &p, Config &root)
         if (!c.second.config)
             throw std::runtime_error("Config was not created for target: " + c.first.target_name);
 
+        // deps of not loaded configs were resolved together with them
+        if (!c.second.config.loaded())
+            continue;
+
         resolve_dependencies(*c.second.config);
     }
 
@@ -134,6 +208,9 @@ void PackageStore::process(const path &p, Config &root)
     {
         if (cc.first == Package())
             continue;
+        // do not load full config without checks
+        if (!cc.second.config.loaded() && !cc.second.config.getSummary().has_checks)
+            continue;
         root.getDefaultProject().checks += cc.second.config->getDefaultProject().checks;
     }
 
@@ -204,6 +281,7 @@ void PackageStore::resolve_dependencies(const Config &c)
         return;
 
     Resolver r;
+    r.lock_file = lock_file;
     r.resolve_dependencies(deps);
     r.assign_dependencies(c.pkg, deps);
 
@@ -221,7 +299,8 @@ void PackageStore::check_deps_changed()
     // now refresh dependencies database only for remote packages
     // this file (local,current,root) packages will be refreshed anyway
     auto &sdb = getServiceDatabase();
-    std::unordered_map<Package, String> clean_pkgs;
+    CleanPlan plan;
+    PackagesSet clean_pkgs;
     for (auto &cc : *this)
     {
         if (cc.first == Package())
@@ -241,25 +320,17 @@ void PackageStore::check_deps_changed()
             // clear exports for this project, so it will be regenerated
             auto p = Printer::create(Settings::get_local_settings().printerType);
             p->clear_export(cc.first.getDirObj());
-            clean_pkgs.emplace(cc.first, h.hash);
+            clean_pkgs.insert(cc.first);
+
+            // dep hash is set only after clean
+            plan.setDependenciesHash(cc.first, h.hash);
         }
     }
 
-    auto &e = getExecutor();
-    std::vector<Future<void>> fs;
-    for (auto &kv : clean_pkgs)
-    {
-        fs.push_back(e.push([&kv, &sdb]
-        {
-            cleanPackages(kv.first.target_name, CleanTarget::Lib | CleanTarget::Bin | CleanTarget::Obj | CleanTarget::Exp);
-            // set dep hash only after clean
-            sdb.setPackageDependenciesHash(kv.first, kv.second);
-        }));
-    }
-    for (auto &f : fs)
-        f.wait();
-    for (auto &f : fs)
-        f.get();
+    const int flags = CleanTarget::Lib | CleanTarget::Bin | CleanTarget::Obj | CleanTarget::Exp;
+    plan.add(clean_pkgs, flags);
+    plan.addDependents(clean_pkgs, flags);
+    plan.execute();
 }
 
 PackageStore::iterator PackageStore::begin()
@@ -306,16 +377,21 @@ void PackageStore::write_index() const
 #endif
 
     auto &sdb = getServiceDatabase();
+    PackagesSet pkgs;
     for (auto &cc : *this)
     {
         if (cc.first == Package())
             continue;
         sdb.addInstalledPackage(cc.first);
+        pkgs.insert(cc.first);
 #ifdef _WIN32
         create_link(cc.first.getDirSrc(), directories.storage_dir_lnk / "src" / (cc.first.target_name + ".lnk"));
         create_link(cc.first.getDirObj(), directories.storage_dir_lnk / "obj" / (cc.first.target_name + ".lnk"));
 #endif
     }
+
+    // for storage gc
+    sdb.setPackagesLastUse(pkgs);
 }
 
 Config *PackageStore::add_config(std::unique_ptr<Config> &&config, bool created)
@@ -324,7 +400,7 @@ Config *PackageStore::add_config(std::unique_ptr<Config> &&config, bool created)
     auto i = config_store.insert(std::move(config));
     packages[cfg->pkg].config = i.first->get();
     packages[cfg->pkg].config->created = created;
-    return packages[cfg->pkg].config;
+    return packages[cfg->pkg].config.get();
 }
 
 Config *PackageStore::add_config(const Package &p, bool local)
@@ -16,18 +16,58 @@
 
 #pragma once
 
+#include "config_summary.h"
 #include "cppan_string.h"
 #include "dependency.h"
 
+#include <functional>
+#include <memory>
+#include <mutex>
+
 struct Config;
 class ProjectPath;
 
+// Full config of the package is loaded on the first access.
+// Until then only its summary is available.
+class LazyConfig
+{
+public:
+    using Loader = std::function<Config*(void)>;
+
+    LazyConfig() = default;
+    LazyConfig(Config *c) : config(c) {}
+
+    LazyConfig &operator=(Config *c);
+
+    Config *get() const;
+    Config *operator->() const { return get(); }
+    Config &operator*() const { return *get(); }
+    explicit operator bool() const { return config || loader; }
+
+    bool loaded() const;
+    void setLoader(const ConfigSummary &summary, Loader loader);
+
+    // taken from the full config when it is loaded
+    const ConfigSummary &getSummary() const;
+    ConfigSummary &getSummary();
+
+private:
+    mutable Config *config = nullptr;
+    mutable Loader loader;
+    mutable std::unique_ptr<ConfigSummary> summary;
+    // configs are loaded from executor threads
+    mutable std::unique_ptr<std::mutex> m{ std::make_unique<std::mutex>() };
+
+    Config *load() const;
+    ConfigSummary &summarize() const;
+};
+
 class PackageStore
 {
 public:
     struct PackageConfig
     {
-        Config *config;
+        LazyConfig config;
         Packages dependencies;
     };
     using PackageConfigs = std::unordered_map<Package, PackageConfig>;
@@ -74,6 +114,7 @@ private:
     std::unordered_map<ProjectPath, path> local_packages;
 
     bool processing = false;
+    path lock_file;
     int downloads = 0;
     bool deps_changed = false;
 
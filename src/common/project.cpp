@@ -20,6 +20,7 @@
 #include "checks_detail.h"
 #include "config.h"
 #include "http.h"
+#include "multi_replace.h"
 #include "resolver.h"
 
 #include "printers/printer.h"
@@ -30,6 +31,7 @@
 #include <boost/nowide/fstream.hpp>
 
 #include <primitives/command.h>
+#include <primitives/executor.h>
 #include <primitives/pack.h>
 
 #include <regex>
@@ -354,18 +356,44 @@ void Patch::patchSources(const Files &files) const
 {
     if (replace.empty() && regex_replace.empty())
         return;
+
+    // all literal patterns are searched in one pass
+    MultiReplacer replacer(replace);
     std::vector<std::pair<std::regex, String>> regex_prepared;
     for (auto &p : regex_replace)
-        regex_prepared.emplace_back(std::regex(p.first), p.second);
-    for (auto &f : files)
+        regex_prepared.emplace_back(std::regex(p.first, std::regex::ECMAScript | std::regex::optimize), p.second);
+
+    auto patch = [&replacer, &regex_prepared](const path &f)
     {
         auto s = read_file(f, true);
-        for (auto &p : replace)
-            boost::algorithm::replace_all(s, p.first, p.second);
+        bool changed = replacer.replace(s);
         for (auto &p : regex_prepared)
+        {
+            // regex_replace() always copies the string
+            if (!std::regex_search(s, p.first))
+                continue;
             s = std::regex_replace(s, p.first, p.second);
-        write_file_if_different(f, s);
+            changed = true;
+        }
+        if (changed)
+            write_file_if_different(f, s);
+    };
+
+    if (files.size() < 2)
+    {
+        for (auto &f : files)
+            patch(f);
+        return;
     }
+
+    Executor e(std::min<size_t>(files.size(), get_max_threads(8)), "Patcher");
+    std::vector<Future<void>> fs;
+    for (auto &f : files)
+        fs.push_back(e.push([&patch, &f] { patch(f); }));
+    for (auto &f : fs)
+        f.wait();
+    for (auto &f : fs)
+        f.get();
 }
 
 Project::Project()
@@ -18,6 +18,38 @@
 
 #include "enums.h"
 
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace
+{
+
+struct PathElementsHash
+{
+    size_t operator()(const ProjectPath::PathElements &pe) const
+    {
+        size_t h = 0;
+        for (const auto &e : pe)
+            hash_combine(h, std::hash<String>()(e));
+        return h;
+    }
+};
+
+// per process table, ids are never released
+struct InternTable
+{
+    std::shared_mutex m;
+    std::unordered_map<ProjectPath::PathElements, uint32_t, PathElementsHash> ids;
+};
+
+InternTable &getInternTable()
+{
+    static InternTable t;
+    return t;
+}
+
+}
+
 bool is_valid_project_path_symbol(int c)
 {
     return
@@ -59,11 +91,35 @@ ProjectPath::ProjectPath(String s)
     }
     if (!s.empty())
         path_elements.emplace_back(prev, s.end());
+    intern();
 }
 
 ProjectPath::ProjectPath(const PathElements &pe)
     : path_elements(pe)
 {
+    intern();
+}
+
+void ProjectPath::intern()
+{
+    if (path_elements.empty())
+    {
+        id = 0;
+        return;
+    }
+
+    auto &t = getInternTable();
+    {
+        std::shared_lock<std::shared_mutex> lk(t.m);
+        auto i = t.ids.find(path_elements);
+        if (i != t.ids.end())
+        {
+            id = i->second;
+            return;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lk(t.m);
+    id = t.ids.emplace(path_elements, (uint32_t)t.ids.size() + 1).first->second;
 }
 
 String ProjectPath::toString(const String &delim) const
@@ -211,12 +267,14 @@ ProjectPath ProjectPath::back(const ProjectPath &root) const
     }
     if (p.path_elements.empty())
         p.path_elements.assign(path_elements.end() - (path_elements.size() - root.path_elements.size()), path_elements.end());
+    p.intern();
     return p;
 }
 
 void ProjectPath::push_back(const PathElement &pe)
 {
     path_elements.push_back(pe);
+    intern();
 }
 
 ProjectPath ProjectPath::operator/(const String &e) const
@@ -232,6 +290,7 @@ ProjectPath ProjectPath::operator/(const ProjectPath &e) const
 {
     auto tmp = *this;
     tmp.path_elements.insert(tmp.path_elements.end(), e.path_elements.begin(), e.path_elements.end());
+    tmp.intern();
     return tmp;
 }
 
@@ -252,5 +311,6 @@ ProjectPath ProjectPath::slice(int start, int end) const
         p.path_elements = decltype(path_elements)(path_elements.begin() + start, path_elements.end());
     else
         p.path_elements = decltype(path_elements)(path_elements.begin() + start, path_elements.begin() + end);
+    p.intern();
     return p;
 }
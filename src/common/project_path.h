@@ -61,15 +61,6 @@ public:
     String toPath() const;
     path toFileSystemPath() const;
 
-    iterator begin()
-    {
-        return path_elements.begin();
-    }
-    iterator end()
-    {
-        return path_elements.end();
-    }
-
     const_iterator begin() const
     {
         return path_elements.begin();
@@ -99,7 +90,7 @@ public:
 
     bool operator==(const ProjectPath &rhs) const
     {
-        return path_elements == rhs.path_elements;
+        return id == rhs.id;
     }
     bool operator!=(const ProjectPath &rhs) const
     {
@@ -146,6 +137,11 @@ public:
 
 private:
     PathElements path_elements;
+    // equal paths have equal ids within the process, 0 is an empty path
+    uint32_t id = 0;
+
+    // must be called after every change of path elements
+    void intern();
 
     friend struct std::hash<ProjectPath>;
 };
@@ -159,10 +155,7 @@ template<> struct hash<ProjectPath>
 {
     size_t operator()(const ProjectPath& ppath) const
     {
-        size_t h = 0;
-        for (const auto &e : ppath.path_elements)
-            hash_combine(h, std::hash<String>()(e));
-        return h;
+        return std::hash<uint32_t>()(ppath.id);
     }
 };
 
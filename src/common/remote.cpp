@@ -16,14 +16,28 @@
 
 #include "remote.h"
 
+#include "database.h"
 #include "hash.h"
+#include "hedged.h"
+#include "http_session.h"
 #include "package.h"
 
 #include <primitives/templates.h>
 
-//#include "logger.h"
+#include <algorithm>
+#include <thread>
+#include <tuple>
+
+#include <primitives/log.h>
 //DECLARE_STATIC_LOGGER(logger, "remote");
 
+// next source is started in parallel, when there are no new bytes during this time
+#define DOWNLOAD_HEDGE_DELAY_MS 3000
+// resumes of interrupted transfer per source
+#define DOWNLOAD_N_TRIES 3
+// failed sources are tried last during this time
+#define DOWNLOAD_SOURCE_FAILURE_TIMEOUT_MINUTES 30
+
 Remotes get_default_remotes()
 {
     static Remotes rms;
@@ -39,41 +53,153 @@ Remotes get_default_remotes()
     return rms;
 }
 
+static String get_host(const String &url)
+{
+    auto p = url.find("://");
+    p = p == url.npos ? 0 : p + 3;
+    return url.substr(p, url.find('/', p) - p);
+}
+
 bool Remote::downloadPackage(const Package &d, const String &hash, const path &fn, bool try_only_first) const
 {
-    auto download_from_source = [&](const auto &s)
+    struct Source
     {
-        try
-        {
-            download_file(s(*this, d), fn);
-        }
-        catch (const std::exception&)
-        {
-            return false;
-        }
-        return check_file_hash(fn, hash);
+        String url;
+        String host;
+        path fn;
+        bool finished = false;
+        bool downloaded = false;
+        bool hash_ok = false;
+        uintmax_t size = 0;
+        std::chrono::milliseconds time{ 0 };
     };
 
+    std::vector<Source> sources;
+    auto add_source = [this, &d, &sources](const auto &s)
+    {
+        Source src;
+        src.url = s(*this, d);
+        src.host = get_host(src.url);
+        sources.push_back(src);
+    };
     for (auto &s : primary_sources)
+        add_source(s);
+    add_source(default_source);
+    for (auto &s : additional_sources)
+        add_source(s);
+    // only the first source is tried
+    if (try_only_first)
+        sources.resize(1);
+
+    // fastest known sources go first, recently failed go last
+    auto &sdb = getServiceDatabase();
+    auto stats = sdb.getDownloadSourcesStats();
+    auto now = Clock::now();
+    auto get_stats = [&stats, &now](const Source &s)
     {
-        if (download_from_source(s))
-            return true;
-        else if (try_only_first)
-            return false;
-    }
+        auto i = stats.find(s.host);
+        if (i == stats.end())
+            return DownloadSourceStats();
+        auto st = i->second;
+        if (now - st.last_failure > std::chrono::minutes(DOWNLOAD_SOURCE_FAILURE_TIMEOUT_MINUTES))
+            st.failures = 0;
+        return st;
+    };
+    std::stable_sort(sources.begin(), sources.end(), [&get_stats](const auto &s1, const auto &s2)
+    {
+        auto st1 = get_stats(s1);
+        auto st2 = get_stats(s2);
+        return std::tie(st1.failures, st2.throughput) < std::tie(st2.failures, st1.throughput);
+    });
+    for (size_t i = 0; i < sources.size(); i++)
+        sources[i].fn = fn.string() + "." + std::to_string(i) + ".part";
 
-    if (download_from_source(default_source))
-        return true;
-    else if (try_only_first)
-        return false;
+    // Sources are raced: the next one is started when the previous one
+    // does not send anything for some time or fails.
+    // The first file with correct hash wins.
+    std::vector<std::atomic<uintmax_t>> received(sources.size());
+    std::vector<uintmax_t> last_received(sources.size());
+    auto winner = hedged_race(sources.size(),
+        [](size_t) { return std::chrono::milliseconds(DOWNLOAD_HEDGE_DELAY_MS); },
+        [&sources, &hash, &received](size_t i, const std::atomic_bool &cancel)
+    {
+        auto &s = sources[i];
+        HttpRequest req = httpSettings;
+        req.url = s.url;
 
-    // no try_only_first for additional sources
-    for (auto &s : additional_sources)
+        HttpDownload opts;
+        opts.cancel = &cancel;
+        opts.received = &received[i];
+
+        auto &session = getHttpSession();
+        auto start = Clock::now();
+        HttpFileInfo resp;
+        for (int t = 0; t < DOWNLOAD_N_TRIES && !cancel; t++)
+        {
+            if (t)
+            {
+                std::this_thread::sleep_for(get_backoff_delay(t - 1));
+                // interrupted transfer is continued from the received part
+                boost::system::error_code ec;
+                auto sz = fs::file_size(s.fn, ec);
+                opts.offset = ec ? 0 : sz;
+                opts.validator = resp.validator;
+            }
+            resp = session.download(req, s.fn, opts);
+            if (resp.http_code != 0)
+                break;
+        }
+        s.time = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+        if (cancel)
+            return HedgeResult::Failure;
+        s.finished = true;
+
+        if (resp.http_code != 200 && resp.http_code != 206)
+            return HedgeResult::Failure;
+        s.downloaded = true;
+        s.size = fs::file_size(s.fn);
+        s.hash_ok = check_file_hash(s.fn, hash);
+        return s.hash_ok ? HedgeResult::Success : HedgeResult::Failure;
+    },
+        [&received, &last_received](size_t i)
+    {
+        // no bytes since the last check, including no first byte yet
+        auto r = received[i].load();
+        auto stalled = r == last_received[i];
+        last_received[i] = r;
+        return stalled;
+    });
+
+    for (auto &s : sources)
+    {
+        if (!s.finished)
+            continue;
+        auto &st = stats[s.host];
+        if (s.downloaded)
+        {
+            auto t = std::max<int64_t>(s.time.count(), 1);
+            auto throughput = (int64_t)s.size * 1000 / t;
+            st.throughput = st.throughput ? (st.throughput * 3 + throughput) / 4 : throughput;
+            st.failures = 0;
+            LOG_DEBUG(logger, "Downloaded " << s.url << " at " << throughput / 1024 << " KB/s");
+        }
+        else
+        {
+            st.failures++;
+            st.last_failure = Clock::now();
+        }
+        sdb.setDownloadSourceStats(s.host, st);
+    }
+
+    boost::system::error_code ec;
+    if (winner != -1)
     {
-        if (download_from_source(s))
-            return true;
+        fs::remove(fn, ec);
+        fs::rename(sources[winner].fn, fn);
     }
-    return true;
+    for (auto &s : sources)
+        fs::remove(s.fn, ec);
+    return winner != -1;
 }
 
 String Remote::default_source_provider(const Package &d) const
@@ -17,10 +17,16 @@
 #include "resolver.h"
 
 #include "access_table.h"
+#include "background.h"
 #include "config.h"
+#include "config_summary.h"
 #include "database.h"
 #include "directories.h"
 #include "exceptions.h"
+#include "hedged.h"
+#include "hash.h"
+#include "http_session.h"
+#include "json.h"
 #include "lock.h"
 #include "project.h"
 #include "settings.h"
@@ -35,15 +41,29 @@
 #include <primitives/pack.h>
 #include <primitives/templates.h>
 
+#include <atomic>
+
 #include <primitives/log.h>
 //DECLARE_STATIC_LOGGER(logger, "resolver");
 
 #define CURRENT_API_LEVEL 1
 
+// delay before the next remote is queried in parallel, when latency is unknown
+// (a half of dependencies request timeout, so slow remotes are not doubled)
+#define REMOTE_HEDGE_DELAY_MS 5000
+// bounds of the delay for remotes with known latency
+#define REMOTE_HEDGE_MIN_DELAY_MS 1000
+#define REMOTE_HEDGE_MAX_DELAY_MS 5000
+// failed remotes are tried last during this time
+#define REMOTE_FAILURE_TIMEOUT_MINUTES 30
+
+// increase when lock file format changes
+#define LOCK_FILE_VERSION 1
+
 TYPED_EXCEPTION(LocalDbHashException);
 TYPED_EXCEPTION(DependencyNotResolved);
 
-Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Remote *current_remote);
+Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Remote *current_remote, const std::atomic_bool *cancel = nullptr);
 Resolver::Dependencies getDependenciesFromDb(const Packages &deps, const Remote *current_remote);
 Resolver::Dependencies prepareIdDependencies(const IdDependencies &id_deps, const Remote *current_remote);
 
@@ -132,34 +152,28 @@ void Resolver::resolve(const Packages &deps, std::function<void()> resolve_actio
 
     // ref to not invalidate all ptrs
     auto &us = Settings::get_user_settings();
-    auto cr = us.remotes.begin();
-    current_remote = &*cr++;
+    current_remote = &us.remotes.front();
 
-    auto resolve_remote_deps = [this, &deps, &cr, &us]()
+    // locked packages are used as is, without any queries,
+    // forced server query refreshes the lock
+    if (!us.force_server_query && read_lock_file(deps))
     {
-        bool again = true;
-        while (again)
+        try
         {
-            again = false;
-            try
-            {
-                if (us.remotes.size() > 1)
-                    LOG_INFO(logger, "Trying " + current_remote->name + " remote");
-                download_dependencies_ = getDependenciesFromRemote(deps, current_remote);
-            }
-            catch (const std::exception &e)
-            {
-                LOG_WARN(logger, e.what());
-                if (cr != us.remotes.end())
-                {
-                    current_remote = &*cr++;
-                    again = true;
-                }
-                else
-                    throw DependencyNotResolved();
-            }
+            // hashes mismatch will throw LocalDbHashException
+            query_local_db = true;
+            resolve_action();
+            return;
+        }
+        catch (std::exception &e)
+        {
+            LOG_WARN(logger, "Cannot use packages from lock file: " << e.what());
         }
-    };
+
+        // locked remote is not used for the usual resolve
+        current_remote = &us.remotes.front();
+        download_dependencies_.clear();
+    }
 
     query_local_db = !us.force_server_query;
     // do 2 attempts: 1) local db, 2) remote db
@@ -179,12 +193,12 @@ void Resolver::resolve(const Packages &deps, std::function<void()> resolve_actio
                     LOG_ERROR(logger, "Cannot get dependencies from local database: " << e.what());
 
                     query_local_db = false;
-                    resolve_remote_deps();
+                    resolve_remote(deps);
                 }
             }
             else
             {
-                resolve_remote_deps();
+                resolve_remote(deps);
             }
 
             resolve_action();
@@ -198,6 +212,202 @@ void Resolver::resolve(const Packages &deps, std::function<void()> resolve_actio
         }
         break;
     }
+
+    write_lock_file(deps);
+}
+
+// healthy remotes keep their order from settings
+static std::vector<const Remote *> order_remotes(const Remotes &remotes, const RemotesHealth &health)
+{
+    auto now = Clock::now();
+    auto failures = [&health, &now](const Remote *r)
+    {
+        auto h = health.find(r->url);
+        if (h == health.end() ||
+            now - h->second.last_failure > std::chrono::minutes(REMOTE_FAILURE_TIMEOUT_MINUTES))
+            return 0;
+        return h->second.failures;
+    };
+
+    std::vector<const Remote *> ordered;
+    for (auto &r : remotes)
+        ordered.push_back(&r);
+    std::stable_sort(ordered.begin(), ordered.end(), [&failures](auto r1, auto r2)
+    {
+        return failures(r1) < failures(r2);
+    });
+    return ordered;
+}
+
+std::chrono::milliseconds get_remote_hedge_delay(const RemotesHealth &health, const String &url)
+{
+    auto h = health.find(url);
+    if (h == health.end() || h->second.latency == 0)
+        return std::chrono::milliseconds(REMOTE_HEDGE_DELAY_MS);
+    // well above usual response time, so only stuck requests are hedged
+    return std::chrono::milliseconds(std::min(std::max(h->second.latency * 3,
+        REMOTE_HEDGE_MIN_DELAY_MS), REMOTE_HEDGE_MAX_DELAY_MS));
+}
+
+void Resolver::resolve_remote(const Packages &deps)
+{
+    auto &us = Settings::get_user_settings();
+    auto &sdb = getServiceDatabase();
+    auto health = sdb.getRemotesHealth();
+    auto remotes = order_remotes(us.remotes, health);
+
+    // Remotes are queried one by one, but the next one is started
+    // without waiting for the previous, when it does not answer in time.
+    // The first valid response wins, others are cancelled.
+    struct Query
+    {
+        bool finished = false;
+        bool ok = false;
+        std::chrono::milliseconds latency{ 0 };
+        Dependencies deps;
+    };
+
+    std::vector<Query> queries(remotes.size());
+    auto winner = hedged_race(remotes.size(),
+        [&remotes, &health](size_t i) { return get_remote_hedge_delay(health, remotes[i]->url); },
+        [&remotes, &queries, &deps](size_t i, const std::atomic_bool &cancel)
+    {
+        if (remotes.size() > 1)
+            LOG_INFO(logger, "Trying " + remotes[i]->name + " remote");
+        auto &q = queries[i];
+        auto start = Clock::now();
+        try
+        {
+            q.deps = getDependenciesFromRemote(deps, remotes[i], &cancel);
+            q.ok = true;
+        }
+        catch (const std::exception &e)
+        {
+            if (!cancel)
+                LOG_WARN(logger, e.what());
+        }
+        q.latency = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+        q.finished = !cancel || q.ok;
+        return q.ok ? HedgeResult::Success : HedgeResult::Failure;
+    });
+
+    // remember remotes health to order them next time
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        auto &q = queries[i];
+        if (!q.finished)
+            continue;
+        auto &h = health[remotes[i]->url];
+        if (q.ok)
+        {
+            auto l = (int)q.latency.count();
+            h.latency = h.latency ? (h.latency * 3 + l) / 4 : l;
+            h.failures = 0;
+        }
+        else
+        {
+            h.failures++;
+            h.last_failure = Clock::now();
+        }
+        sdb.setRemoteHealth(remotes[i]->url, h);
+    }
+
+    if (winner == -1)
+        throw DependencyNotResolved();
+    current_remote = remotes[winner];
+    download_dependencies_ = std::move(queries[winner].deps);
+}
+
+static String get_lock_hash(const Packages &deps)
+{
+    std::map<String, String> sorted;
+    for (auto &d : deps)
+        sorted[d.first] = d.second.version.toAnyVersion() + " " + std::to_string(d.second.flags.to_ullong());
+    String s;
+    for (auto &d : sorted)
+        s += d.first + " " + d.second + "\n";
+    return sha256_counted(s);
+}
+
+bool Resolver::read_lock_file(const Packages &deps)
+{
+    if (lock_file.empty() || !fs::exists(lock_file))
+        return false;
+
+    IdDependencies id_deps;
+    const Remote *remote = current_remote;
+    try
+    {
+        auto root = YAML::Load(read_file(lock_file));
+        if (root["version"].as<int>(0) != LOCK_FILE_VERSION)
+            return false;
+        auto locked = root["locks"][get_lock_hash(deps)];
+        if (!locked.IsDefined())
+            return false;
+
+        auto remote_name = locked["remote"].as<String>("");
+        for (auto &r : Settings::get_user_settings().remotes)
+        {
+            if (r.name == remote_name)
+                remote = &r;
+        }
+
+        for (const auto &v : locked["packages"])
+        {
+            DownloadDependency d;
+            d.id = v.first.as<ProjectVersionId>();
+            d.ppath = v.second["ppath"].as<String>();
+            d.version = v.second["version"].as<String>();
+            d.flags = v.second["flags"].as<uint64_t>();
+            d.hash = v.second["hash"].as<String>();
+            std::unordered_set<ProjectVersionId> idx;
+            for (const auto &dep : v.second["dependencies"])
+                idx.insert(dep.as<ProjectVersionId>());
+            d.setDependencyIds(idx);
+            id_deps[d.id] = d;
+        }
+        download_dependencies_ = prepareIdDependencies(id_deps, remote);
+    }
+    catch (std::exception &e)
+    {
+        LOG_WARN(logger, "Cannot read lock file " << lock_file.string() << ": " << e.what());
+        return false;
+    }
+
+    current_remote = remote;
+    LOG_DEBUG(logger, "Using lock file: " << lock_file.string());
+    return true;
+}
+
+void Resolver::write_lock_file(const Packages &deps) const
+{
+    if (lock_file.empty() || download_dependencies_.empty())
+        return;
+
+    // sorted output, so the file is stable between runs
+    std::map<ProjectVersionId, const DownloadDependency *> packages;
+    for (auto &dd : download_dependencies_)
+        packages[dd.second.id] = &dd.second;
+
+    yaml locked;
+    locked["remote"] = current_remote->name;
+    for (auto &[id, d] : packages)
+    {
+        auto n = locked["packages"][std::to_string(id)];
+        n["ppath"] = d->ppath.toString();
+        n["version"] = d->version.toString();
+        n["flags"] = d->flags.to_ullong();
+        n["hash"] = d->hash;
+        std::set<ProjectVersionId> idx(d->getDependencyIds().begin(), d->getDependencyIds().end());
+        for (auto &i : idx)
+            n["dependencies"].push_back(i);
+    }
+
+    // only the current dependency set is kept, so there are no stale entries
+    yaml root;
+    root["version"] = LOCK_FILE_VERSION;
+    root["locks"][get_lock_hash(deps)] = locked;
+    write_file_if_different(lock_file, YAML::Dump(root));
 }
 
 void Resolver::download(const ExtendedPackageData &d, const path &fn)
@@ -319,61 +529,68 @@ void Resolver::download_and_unpack()
     for (auto &f : fs)
         f.get();
 
-    // two following blocks use executor to do parallel queries
-    if (query_local_db)
+    // send download action once
+    bool send_client_call = false;
+    RUN_ONCE
+    {
+        send_client_call = true;
+    };
+
+    // telemetry requests are sent one by one in a single background task,
+    // so they share one connection and do not delay the build
+    if (current_remote && (query_local_db || send_client_call))
     {
-        // send download list
-        // remove this when cppan will be widely used
-        // also because this download count can be easily abused
-        e.push([this]()
+        std::vector<ProjectVersionId> vids;
+        if (query_local_db)
         {
-            if (!current_remote)
-                return;
-
-            ptree request;
-            ptree children;
             for (auto &d : download_dependencies_)
-            {
-                ptree c;
-                c.put("", d.second.id);
-                children.push_back(std::make_pair("", c));
-            }
-            request.add_child("vids", children);
-
-            try
-            {
-                HttpRequest req = httpSettings;
-                req.type = HttpRequest::Post;
-                req.url = current_remote->url + "/api/add_downloads";
-                req.data = ptree2string(request);
-                auto resp = url_request(req);
-            }
-            catch (...)
-            {
-            }
-        });
-    }
+                vids.push_back(d.second.id);
+        }
 
-    // send download action once
-    RUN_ONCE
-    {
-        e.push([this]
+        auto url = current_remote->url;
+        run_background([url, send_downloads = query_local_db, send_client_call, vids](const auto &cancel)
         {
-            try
+            auto &session = getHttpSession();
+            HttpRequest req = httpSettings;
+            req.type = HttpRequest::Post;
+            req.connect_timeout = 2;
+            req.timeout = 3;
+
+            // send download list
+            // remove this when cppan will be widely used
+            // also because this download count can be easily abused
+            if (send_downloads)
             {
-                HttpRequest req = httpSettings;
-                req.type = HttpRequest::Post;
-                req.url = current_remote->url + "/api/add_client_call";
-                req.data = "{}"; // empty json
-                auto resp = url_request(req);
+                JsonValue request;
+                auto &jvids = request["vids"] = JsonValue(JsonValue::Type::Array);
+                for (auto &id : vids)
+                    jvids.push_back(std::to_string(id));
+
+                try
+                {
+                    req.url = url + "/api/add_downloads";
+                    req.data = request.dump();
+                    session.request(req, &cancel);
+                }
+                catch (...)
+                {
+                }
             }
-            catch (...)
+
+            if (send_client_call && !cancel)
             {
+                try
+                {
+                    req.url = url + "/api/add_client_call";
+                    req.data = "{}"; // empty json
+                    session.request(req, &cancel);
+                }
+                catch (...)
+                {
+                }
             }
         });
-    };
-
-    e.wait();
+    }
 }
 
 void Resolver::post_download()
@@ -386,30 +603,21 @@ void Resolver::post_download()
     }
 }
 
-void Resolver::prepare_config(PackageStore::PackageConfigs::value_type &cc)
+// extract real deps flags from downloaded deps
+static void apply_dependencies(Packages &project_dependencies, const DownloadDependency::Dependencies &download_dependencies, Packages *dependencies)
 {
-    auto &p = cc.first;
-    auto &c = cc.second.config;
-    auto &dependencies = cc.second.dependencies;
-    c->setPackage(p);
-    auto &project = c->getDefaultProject(p.ppath);
-
-    if (p.flags[pfLocalProject])
-        return;
-
-    // prepare deps: extract real deps flags from configs
-    for (auto &dep : download_dependencies_[p].dependencies)
+    for (auto &dep : download_dependencies)
     {
         auto d = dep.second;
-        auto i = project.dependencies.find(d.ppath.toString());
-        if (i == project.dependencies.end())
+        auto i = project_dependencies.find(d.ppath.toString());
+        if (i == project_dependencies.end())
         {
             // check if we chose a root project that matches all subprojects
             Packages to_add;
             std::set<String> to_remove;
-            for (auto &root_dep : project.dependencies)
+            for (auto &root_dep : project_dependencies)
             {
-                for (auto &child_dep : download_dependencies_[p].dependencies)
+                for (auto &child_dep : download_dependencies)
                 {
                     if (root_dep.second.ppath.is_root_of(child_dep.second.ppath))
                     {
@@ -421,17 +629,42 @@ void Resolver::prepare_config(PackageStore::PackageConfigs::value_type &cc)
             if (to_add.empty())
                 throw std::runtime_error("dependency '" + d.ppath.toString() + "' not found");
             for (auto &r : to_remove)
-                project.dependencies.erase(r);
+                project_dependencies.erase(r);
             for (auto &a : to_add)
-                project.dependencies.insert(a);
+                project_dependencies.insert(a);
             continue;
         }
         d.flags[pfIncludeDirectoriesOnly] = i->second.flags[pfIncludeDirectoriesOnly];
         i->second.version = d.version;
         i->second.flags = d.flags;
-        dependencies.emplace(d.ppath.toString(), d);
+        if (dependencies)
+            dependencies->emplace(d.ppath.toString(), d);
+    }
+}
+
+void Resolver::prepare_config(PackageStore::PackageConfigs::value_type &cc)
+{
+    auto &p = cc.first;
+    auto &c = cc.second.config;
+    auto &dependencies = cc.second.dependencies;
+
+    // the loader will prepare the full config
+    if (!c.loaded())
+    {
+        auto &summary = c.getSummary();
+        apply_dependencies(summary.dependencies, download_dependencies_[p].dependencies, &dependencies);
+        return;
     }
 
+    c->setPackage(p);
+    auto &project = c->getDefaultProject(p.ppath);
+
+    if (p.flags[pfLocalProject])
+        return;
+
+    // prepare deps: extract real deps flags from configs
+    apply_dependencies(project.dependencies, download_dependencies_[p].dependencies, &dependencies);
+
     c->post_download();
 }
 
@@ -440,24 +673,28 @@ void Resolver::read_configs()
     if (download_dependencies_.empty())
         return;
     LOG_INFO(logger, "Reading package specs... ");
-    for (auto &d : download_dependencies_)
-        read_config(d.second);
-}
 
-void Resolver::read_config(const ExtendedPackageData &d)
-{
-    if (!fs::exists(d.getDirSrc()))
+    // full configs are parsed only when summaries are outdated
+    auto &sdb = getServiceDatabase();
+    auto summaries = sdb.getConfigSummaries();
+    ServiceDatabase::ConfigSummaries new_summaries;
+    for (auto &d : download_dependencies_)
     {
-        LOG_DEBUG(logger, "Config dir does not exist: " << d.target_name);
-        return;
-    }
+        if (read_config_summary(d.second, summaries))
+            continue;
+        read_config(d.second);
 
-    if (rd.packages.find(d) != rd.packages.end())
-    {
-        LOG_DEBUG(logger, "Package does not exist: " << d.target_name);
-        return;
+        auto i = rd.packages.find(d.second);
+        if (i == rd.packages.end() || !i->second.config.loaded() || d.second.hash.empty())
+            continue;
+        ConfigSummary summary(*i->second.config, d.second);
+        new_summaries[d.second.getHash()] = { d.second.hash, summary.save() };
     }
+    sdb.setConfigSummaries(new_summaries);
+}
 
+static Config *create_config(const ExtendedPackageData &d)
+{
     // CPPAN_FILENAME must exist
     if (!fs::exists(d.getDirSrc() / CPPAN_FILENAME))
     {
@@ -466,16 +703,10 @@ void Resolver::read_config(const ExtendedPackageData &d)
         throw std::runtime_error("There is an error that cannot be resolved during this run, please, restart the program");
     }
 
-    // keep some set data for re-read configs
-    //auto oldi = rd.packages.find(d);
-    // Config::created is needed for patching sources and other initialization stuff
-    //bool created = oldi != rd.packages.end() && oldi->second.config->created;
-
     try
     {
-        auto p = rd.config_store.insert(std::make_unique<Config>(d.getDirSrc(), false));
-        /*auto ptr = */rd.packages[d].config = p.first->get();
-        //ptr->created = created;
+        auto p = rd.config_store.insert(std::make_unique<Config>(d.getDirSrc(), d.getConfigCacheFilename()));
+        return p.first->get();
     }
     catch (DependencyNotResolved &)
     {
@@ -492,6 +723,53 @@ void Resolver::read_config(const ExtendedPackageData &d)
     }
 }
 
+bool Resolver::read_config_summary(const ExtendedPackageData &d, const ServiceDatabase::ConfigSummaries &summaries)
+{
+    if (d.hash.empty() || rd.packages.find(d) != rd.packages.end() || !fs::exists(d.getDirSrc()))
+        return false;
+
+    auto i = summaries.find(d.getHash());
+    if (i == summaries.end() || i->second.first != d.hash)
+        return false;
+
+    ConfigSummary summary;
+    if (!summary.load(i->second.second))
+        return false;
+
+    auto download_dependencies = download_dependencies_[d].dependencies;
+    rd.packages[d].config.setLoader(summary, [d, download_dependencies]
+    {
+        auto c = create_config(d);
+        c->setPackage(d);
+        apply_dependencies(c->getDefaultProject(d.ppath).dependencies, download_dependencies, nullptr);
+        return c;
+    });
+    return true;
+}
+
+void Resolver::read_config(const ExtendedPackageData &d)
+{
+    if (!fs::exists(d.getDirSrc()))
+    {
+        LOG_DEBUG(logger, "Config dir does not exist: " << d.target_name);
+        return;
+    }
+
+    if (rd.packages.find(d) != rd.packages.end())
+    {
+        LOG_DEBUG(logger, "Package does not exist: " << d.target_name);
+        return;
+    }
+
+    // keep some set data for re-read configs
+    //auto oldi = rd.packages.find(d);
+    // Config::created is needed for patching sources and other initialization stuff
+    //bool created = oldi != rd.packages.end() && oldi->second.config->created;
+
+    /*auto ptr = */rd.packages[d].config = create_config(d);
+    //ptr->created = created;
+}
+
 void Resolver::assign_dependencies(const Package &pkg, const Packages &deps)
 {
     rd.packages[pkg].dependencies.insert(deps.begin(), deps.end());
@@ -532,84 +810,58 @@ void Resolver::assign_dependencies(const Package &pkg, const Packages &deps)
     }
 }
 
-Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Remote *current_remote)
+Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Remote *current_remote, const std::atomic_bool *cancel)
 {
     // prepare request
-    ptree request;
-    ptree dependency_tree;
+    JsonValue request(JsonValue::Type::Object);
+    JsonValue dependency_tree;
     for (auto &d : deps)
-    {
-        ptree version;
-        version.put("version", d.second.version.toAnyVersion());
-        request.put_child(ptree::path_type(d.second.ppath.toString(), '|'), version);
-    }
+        request[d.second.ppath.toString()]["version"] = d.second.version.toAnyVersion();
 
     LOG_INFO(logger, "Requesting dependency list... ");
     {
-        int ct = 5;
-        int t = 10;
-        int n_tries = 3;
-        while (1)
+        HttpRequest req = httpSettings;
+        req.connect_timeout = 5;
+        req.timeout = 10;
+        req.type = HttpRequest::Post;
+        req.url = current_remote->url + "/api/find_dependencies";
+        req.data = request.dump();
+        auto resp = getHttpSession().request(req, 3, cancel);
+        switch (resp.http_code)
+        {
+        case 200:
+            dependency_tree = JsonValue::parse(resp.response);
+            break;
+        case 0:
+            if (!cancel || !*cancel)
+                LOG_WARN(logger, "Could not connect to server: " + resp.error);
+            throw std::runtime_error("Cannot get deps");
+        default:
         {
-            HttpResponse resp;
+            String err = "Error code: " + std::to_string(resp.http_code);
             try
             {
-                HttpRequest req = httpSettings;
-                req.connect_timeout = ct;
-                req.timeout = t;
-                req.type = HttpRequest::Post;
-                req.url = current_remote->url + "/api/find_dependencies";
-                req.data = ptree2string(request);
-                resp = url_request(req);
-                if (resp.http_code != 200)
-                    throw std::runtime_error("Cannot get deps");
-                dependency_tree = string2ptree(resp.response);
-                break;
+                auto e = JsonValue::parse(resp.response).get("error", "");
+                if (!e.empty())
+                    err = e;
             }
             catch (...)
             {
-                if (--n_tries == 0)
-                {
-                    switch (resp.http_code)
-                    {
-                    case 200:
-                    {
-                        dependency_tree = string2ptree(resp.response);
-                        auto e = dependency_tree.find("error");
-                        LOG_WARN(logger, e->second.get_value<String>());
-                    }
-                    break;
-                    case 0:
-                        LOG_WARN(logger, "Could not connect to server");
-                        break;
-                    default:
-                        LOG_WARN(logger, "Error code: " + std::to_string(resp.http_code));
-                        break;
-                    }
-                    throw;
-                }
-                else if (resp.http_code == 0)
-                {
-                    ct /= 2;
-                    t /= 2;
-                }
-                LOG_INFO(logger, "Retrying... ");
             }
+            LOG_WARN(logger, err);
+            throw std::runtime_error("Cannot get deps");
+        }
         }
     }
 
     // read deps urls, download them, unpack
-    int api = 0;
-    if (dependency_tree.find("api") != dependency_tree.not_found())
-        api = dependency_tree.get<int>("api");
+    int api = dependency_tree.get<int>("api", 0);
 
-    auto e = dependency_tree.find("error");
-    if (e != dependency_tree.not_found())
-        throw std::runtime_error(e->second.get_value<String>());
+    if (auto e = dependency_tree.find("error"))
+        throw std::runtime_error(e->get<String>());
 
-    auto info = dependency_tree.find("info");
-    if (info != dependency_tree.not_found())
-        LOG_INFO(logger, info->second.get_value<String>());
+    if (auto info = dependency_tree.find("info"))
+        LOG_INFO(logger, info->get<String>());
 
     if (api == 0)
         throw std::runtime_error("API version is missing in the response");
@@ -622,25 +874,26 @@ Resolver::Dependencies getDependenciesFromRemote(const Packages &deps, const Rem
 
     // set id dependencies
     IdDependencies id_deps;
-    auto &remote_packages = dependency_tree.get_child("packages");
-    for (auto &v : remote_packages)
+    for (auto &v : dependency_tree.at("packages").getObject())
     {
         auto id = v.second.get<ProjectVersionId>("id");
 
         DownloadDependency d;
+        d.id = id;
         d.ppath = v.first;
         d.version = v.second.get<String>("version");
         d.flags = decltype(d.flags)(v.second.get<uint64_t>("flags"));
         // TODO: remove later sha256 field
-        d.hash = v.second.get<String>("sha256", "empty_hash");
+        d.hash = v.second.get("sha256", "empty_hash");
         if (d.hash == "empty_hash")
-            d.hash = v.second.get<String>("hash", "empty_hash");
+            d.hash = v.second.get("hash", "empty_hash");
 
-        if (v.second.find(DEPENDENCIES_NODE) != v.second.not_found())
+        if (auto tree_deps = v.second.find(DEPENDENCIES_NODE))
         {
             std::unordered_set<ProjectVersionId> idx;
-            for (auto &tree_dep : v.second.get_child(DEPENDENCIES_NODE))
-                idx.insert(tree_dep.second.get_value<ProjectVersionId>());
+            idx.reserve(tree_deps->size());
+            for (auto &tree_dep : tree_deps->getArray())
+                idx.insert(tree_dep.get<ProjectVersionId>());
             d.setDependencyIds(idx);
         }
 
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "database.h"
 #include "dependency.h"
 #include "package_store.h"
 
@@ -26,6 +27,8 @@ public:
 
 public:
     PackagesMap resolved_packages;
+    // project lock file, if empty - not used
+    path lock_file;
 
     void resolve_dependencies(const Packages &deps);
     void resolve_and_download(const Package &p, const path &fn);
@@ -41,11 +44,18 @@ private:
     void post_download();
     void prepare_config(PackageStore::PackageConfigs::value_type &cc);
     void read_config(const ExtendedPackageData &d);
+    bool read_config_summary(const ExtendedPackageData &d, const ServiceDatabase::ConfigSummaries &summaries);
 
     void resolve(const Packages &deps, std::function<void()> resolve_action);
+    void resolve_remote(const Packages &deps);
+    bool read_lock_file(const Packages &deps);
+    void write_lock_file(const Packages &deps) const;
     void download(const ExtendedPackageData &d, const path &fn);
 };
 
 void resolve_and_download(const Package &p, const path &fn);
 std::tuple<Package, PackagesSet> resolve_dependency(const String &d);
 PackagesMap resolve_dependencies(const Packages &deps);
+
+// delay before the next remote is queried, while this one does not answer
+std::chrono::milliseconds get_remote_hedge_delay(const RemotesHealth &health, const String &url);
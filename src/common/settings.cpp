@@ -22,6 +22,7 @@
 #include "directories.h"
 #include "exceptions.h"
 #include "hash.h"
+#include "http_session.h"
 #include "program.h"
 #include "stamp.h"
 
@@ -34,6 +35,9 @@
 #include <primitives/log.h>
 //DECLARE_STATIC_LOGGER(logger, "settings");
 
+#define SETTINGS_HASH_INPUTS_FILE "settings_hash_inputs.txt"
+#define CLIENT_STAMP_FILE "client.stamp"
+
 void BuildSettings::set_build_dirs(const String &name)
 {
     filename = name;
@@ -73,6 +77,7 @@ void Settings::load(const path &p, const SettingsType type)
 
 void Settings::load(const yaml &root, const SettingsType type)
 {
+    hash.clear();
     load_main(root, type);
 
     auto get_storage_dir = [this](SettingsType type)
@@ -145,10 +150,16 @@ void Settings::load_main(const yaml &root, const SettingsType type)
             remotes.push_back(*prm);
     });
 
+    get_map_and_iterate(root, "archive_providers", [this](auto &kv)
+    {
+        archive_providers[kv.first.template as<String>()] = kv.second.template as<String>();
+    });
+
     YAML_EXTRACT_AUTO(disable_update_checks);
     YAML_EXTRACT_AUTO(max_download_threads);
     YAML_EXTRACT_AUTO(debug_generated_cmake_configs);
     YAML_EXTRACT_AUTO(install_local_packages);
+    YAML_EXTRACT_AUTO(storage_gc_budget_mb);
     YAML_EXTRACT(storage_dir, String);
     YAML_EXTRACT(build_dir, String);
     YAML_EXTRACT(cppan_dir, String);
@@ -341,8 +352,70 @@ bool Settings::is_custom_build_dir() const
     return build_dir_type == SettingsType::Local || build_dir_type == SettingsType::None;
 }
 
+// environment is read once, so all hashes of this process agree
+// even when we set variables for child processes later
+static const std::vector<std::pair<String, String>> &get_env_hash_inputs()
+{
+    static const auto env = []
+    {
+        // besides we track all valuable ENV vars
+        // to be sure that we'll load correct config
+        static const char *vars[] =
+        {
+            "PATH",
+            "Path",
+            "FPATH",
+            "CPATH",
+
+            // windows, msvc
+            "VSCOMNTOOLS",
+            "VS71COMNTOOLS",
+            "VS80COMNTOOLS",
+            "VS90COMNTOOLS",
+            "VS100COMNTOOLS",
+            "VS110COMNTOOLS",
+            "VS120COMNTOOLS",
+            "VS130COMNTOOLS",
+            "VS140COMNTOOLS",
+            "VS141COMNTOOLS", // 2017?
+            "VS150COMNTOOLS",
+            "VS151COMNTOOLS",
+            "VS160COMNTOOLS", // for the future
+
+            "INCLUDE",
+            "LIB",
+
+            // gcc
+            "COMPILER_PATH",
+            "LIBRARY_PATH",
+            "C_INCLUDE_PATH",
+            "CPLUS_INCLUDE_PATH",
+            "OBJC_INCLUDE_PATH",
+            //"LD_LIBRARY_PATH", // do we need these?
+            //"DYLD_LIBRARY_PATH",
+
+            "CC",
+            "CFLAGS",
+            "CXXFLAGS",
+            "CPPFLAGS",
+        };
+
+        std::vector<std::pair<String, String>> env;
+        for (auto v : vars)
+        {
+            if (auto e = getenv(v))
+                env.emplace_back(v, e);
+        }
+        return env;
+    }();
+    return env;
+}
+
 String Settings::get_hash() const
 {
+    if (!hash.empty())
+        return hash;
+
     Hasher h;
     h |= c_compiler;
     h |= cxx_compiler;
@@ -366,55 +439,100 @@ String Settings::get_hash() const
     h |= use_shared_libs;
     h |= configuration;
     h |= default_configuration;
+    for (auto &e : get_env_hash_inputs())
+        h |= e.second;
+
+    hash = h.hash;
+    return hash;
+}
+
+Settings::HashInputs Settings::get_hash_inputs() const
+{
+    static const char *confs[] = { "debug", "minsizerel", "release", "relwithdebinfo" };
 
-    // besides we track all valuable ENV vars
-    // to be sure that we'll load correct config
-    auto add_env = [&h](const char *var)
+    HashInputs inputs;
+    auto add = [&inputs](const String &name, const String &value)
     {
-        auto e = getenv(var);
-        if (!e)
-            return;
-        h |= String(e);
+        inputs.emplace_back(name, value);
+    };
+    auto add_conf = [&add](const String &name, const String *values)
+    {
+        for (int i = 0; i < CMakeConfigurationType::Max; i++)
+            add(name + "_" + confs[i], values[i]);
     };
 
-    add_env("PATH");
-    add_env("Path");
-    add_env("FPATH");
-    add_env("CPATH");
-
-    // windows, msvc
-    add_env("VSCOMNTOOLS");
-    add_env("VS71COMNTOOLS");
-    add_env("VS80COMNTOOLS");
-    add_env("VS90COMNTOOLS");
-    add_env("VS100COMNTOOLS");
-    add_env("VS110COMNTOOLS");
-    add_env("VS120COMNTOOLS");
-    add_env("VS130COMNTOOLS");
-    add_env("VS140COMNTOOLS");
-    add_env("VS141COMNTOOLS"); // 2017?
-    add_env("VS150COMNTOOLS");
-    add_env("VS151COMNTOOLS");
-    add_env("VS160COMNTOOLS"); // for the future
-
-    add_env("INCLUDE");
-    add_env("LIB");
-
-    // gcc
-    add_env("COMPILER_PATH");
-    add_env("LIBRARY_PATH");
-    add_env("C_INCLUDE_PATH");
-    add_env("CPLUS_INCLUDE_PATH");
-    add_env("OBJC_INCLUDE_PATH");
-    //add_env("LD_LIBRARY_PATH"); // do we need these?
-    //add_env("DYLD_LIBRARY_PATH");
-
-    add_env("CC");
-    add_env("CFLAGS");
-    add_env("CXXFLAGS");
-    add_env("CPPFLAGS");
-
-    return h.hash;
+    add("c_compiler", c_compiler);
+    add("cxx_compiler", cxx_compiler);
+    add("compiler", compiler);
+    add("c_compiler_flags", c_compiler_flags);
+    add_conf("c_compiler_flags", c_compiler_flags_conf);
+    add("cxx_compiler_flags", cxx_compiler_flags);
+    add_conf("cxx_compiler_flags", cxx_compiler_flags_conf);
+    add("compiler_flags", compiler_flags);
+    add_conf("compiler_flags", compiler_flags_conf);
+    add("link_flags", link_flags);
+    add_conf("link_flags", link_flags_conf);
+    add("link_libraries", link_libraries);
+    add("generator", generator);
+    add("system_version", system_version);
+    add("toolset", toolset);
+    add("use_shared_libs", std::to_string(use_shared_libs));
+    add("configuration", configuration);
+    add("default_configuration", default_configuration);
+    for (auto &e : get_env_hash_inputs())
+        add("env " + e.first, e.second);
+    return inputs;
+}
+
+static path get_hash_inputs_filename()
+{
+    return directories.storage_dir_etc / SETTINGS_HASH_INPUTS_FILE;
+}
+
+void Settings::save_hash_inputs() const
+{
+    // values may be long or private, keep only their hashes
+    String s;
+    for (auto &i : get_hash_inputs())
+        s += i.first + "\t" + sha256_short(i.second) + "\n";
+    write_file(get_hash_inputs_filename(), s);
+}
+
+Strings Settings::get_changed_hash_inputs() const
+{
+    auto fn = get_hash_inputs_filename();
+    if (!fs::exists(fn))
+        return {};
+
+    std::map<String, String> old;
+    for (auto &line : read_lines(fn))
+    {
+        auto p = line.find('\t');
+        if (p != line.npos)
+            old[line.substr(0, p)] = line.substr(p + 1);
+    }
+
+    Strings changed;
+    for (auto &i : get_hash_inputs())
+    {
+        auto o = old.find(i.first);
+        if (o == old.end())
+            changed.push_back(i.first + " (added)");
+        else
+        {
+            if (o->second != sha256_short(i.second))
+                changed.push_back(i.first);
+            old.erase(o);
+        }
+    }
+    for (auto &o : old)
+        changed.push_back(o.first + " (removed)");
+    return changed;
+}
+
+static path get_client_stamp_filename()
+{
+    return directories.storage_dir_etc / CLIENT_STAMP_FILE;
 }
 
 bool Settings::checkForUpdates() const
@@ -422,21 +540,20 @@ bool Settings::checkForUpdates() const
     if (disable_update_checks)
         return false;
 
-#ifdef _WIN32
-    String stamp_file = "/client/.service/win32.stamp";
-#elif __APPLE__
-    String stamp_file = "/client/.service/macos.stamp";
-#else
-    String stamp_file = "/client/.service/linux.stamp";
-#endif
+    auto fn = get_client_stamp_filename();
+    if (!fs::exists(fn))
+        return false;
 
-    auto fn = fs::temp_directory_path() / fs::unique_path();
-    download_file(remotes[0].url + stamp_file, fn);
-    auto stamp_remote = boost::trim_copy(read_file(fn));
-    fs::remove(fn);
-    boost::replace_all(stamp_remote, "\"", "");
-    uint64_t s1 = std::stoull(cppan_stamp);
-    uint64_t s2 = std::stoull(stamp_remote);
+    uint64_t s1 = 0, s2 = 0;
+    try
+    {
+        s1 = std::stoull(cppan_stamp);
+        s2 = std::stoull(read_file(fn));
+    }
+    catch (std::exception &)
+    {
+        return false;
+    }
     if (!(s1 != 0 && s2 != 0 && s2 > s1))
         return false;
 
@@ -453,6 +570,31 @@ bool Settings::checkForUpdates() const
     return true;
 }
 
+void Settings::updateClientStamp(const std::atomic_bool &cancel) const
+{
+#ifdef _WIN32
+    String stamp_file = "/client/.service/win32.stamp";
+#elif __APPLE__
+    String stamp_file = "/client/.service/macos.stamp";
+#else
+    String stamp_file = "/client/.service/linux.stamp";
+#endif
+
+    HttpRequest req = httpSettings;
+    req.url = remotes[0].url + stamp_file;
+    req.connect_timeout = 2;
+    req.timeout = 3;
+    auto resp = getHttpSession().request(req, &cancel);
+    if (resp.http_code != 200)
+        return;
+
+    auto stamp_remote = boost::trim_copy(resp.response);
+    boost::replace_all(stamp_remote, "\"", "");
+    if (std::stoull(stamp_remote) == 0)
+        return;
+    write_file(get_client_stamp_filename(), stamp_remote);
+}
+
 Settings &Settings::get(SettingsType type)
 {
     static Settings settings[toIndex(SettingsType::Max) + 1];
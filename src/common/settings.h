@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "archive_provider.h"
 #include "cppan_string.h"
 #include "filesystem.h"
 #include "http.h"
@@ -27,6 +28,7 @@
 
 #include <primitives/executor.h>
 
+#include <atomic>
 #include <map>
 
 void cleanConfig(const String &config);
@@ -50,6 +52,8 @@ struct BuildSettings
 
 struct Settings
 {
+    using HashInputs = std::vector<std::pair<String, String>>;
+
     enum CMakeConfigurationType
     {
         Debug,
@@ -63,6 +67,8 @@ struct Settings
     // connection
     Remotes remotes{ get_default_remotes() };
     ProxySettings proxy;
+    // host -> url template of source archives
+    ArchiveProviders archive_providers{ get_default_archive_providers() };
 
     // sys/user config settings
     SettingsType storage_dir_type{ SettingsType::User };
@@ -78,6 +84,8 @@ struct Settings
     int max_download_threads = get_max_threads(8);
     bool debug_generated_cmake_configs = false;
     bool install_local_packages = false;
+    // storage size limit for gc, 0 - disable automatic gc
+    int storage_gc_budget_mb = 0;
 
     // build settings
     String c_compiler;
@@ -152,10 +160,21 @@ public:
     void save(const path &p) const;
 
     bool is_custom_build_dir() const;
+    // computed once, reset on load
     String get_hash() const;
+    // named values that make the hash
+    HashInputs get_hash_inputs() const;
+    // to explain config misses
+    void save_hash_inputs() const;
+    Strings get_changed_hash_inputs() const;
+    // uses result of the previous background check, no network here
     bool checkForUpdates() const;
+    // downloads and saves stamp of the latest client
+    void updateClientStamp(const std::atomic_bool &cancel) const;
 
 private:
+    mutable String hash;
+
     void load_main(const yaml &root, const SettingsType type);
     void load_build(const yaml &root);
 
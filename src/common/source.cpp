@@ -16,16 +16,26 @@
 
 #include "source.h"
 
+#include "archive_provider.h"
+#include "download.h"
+#include "hash.h"
 #include "http.h"
+#include "lock.h"
+#include "settings.h"
 #include "yaml.h"
 
+#include <boost/algorithm/string.hpp>
 #include <fmt/format.h>
 #include <primitives/command.h>
+#include <primitives/date_time.h>
 #include <primitives/overloads.h>
 #include <primitives/pack.h>
 
 #include <regex>
 
+#include <primitives/log.h>
+//DECLARE_STATIC_LOGGER(logger, "source");
+
 #define PTREE_ADD(x) p.add(#x, x)
 #define PTREE_ADD_NOT_EMPTY(x) if (!x.empty()) PTREE_ADD(x)
 #define PTREE_ADD_NOT_MINUS_ONE(x) if (x != -1) PTREE_ADD(x)
@@ -59,7 +69,7 @@ void applyVersion(String &s, const Version &v)
 static void download_file_checked(const String &url, const path &fn, int64_t max_file_size = 0)
 {
     checkSourceUrl(url);
-    download_file(url, fn, max_file_size);
+    download_file_resumable(url, fn, max_file_size);
 }
 
 static void download_and_unpack(const String &url, const path &fn, int64_t max_file_size = 0)
@@ -88,6 +98,65 @@ static void downloadRepository(F &&f)
     }
 }
 
+// Mirrors are kept in the storage and shared by all downloads of the same url,
+// so only new objects are fetched from the network.
+path get_vcs_mirrors_dir()
+{
+    return directories.storage_dir_etc / "vcs";
+}
+
+static path get_vcs_mirror_dir(const String &vcs, const String &url)
+{
+    return get_vcs_mirrors_dir() / vcs / shorten_hash(sha256_counted(url));
+}
+
+path get_vcs_mirror_lock(const path &mirror)
+{
+    return get_lock("vcs_" + mirror.parent_path().filename().string() + "_" + mirror.filename().string());
+}
+
+// fetches do not always change the mirror, so last use is recorded explicitly for storage gc
+static void touch_vcs_mirror(const path &mirror)
+{
+    boost::system::error_code ec;
+    fs::last_write_time(mirror, time(nullptr), ec);
+}
+
+static bool execute_ok(const Strings &args)
+{
+    std::error_code ec;
+    Command::execute(args, ec);
+    return !ec;
+}
+
+// first clone goes to a temp dir, so broken clones are not used later
+template <typename F>
+static void create_vcs_mirror(const path &mirror, F &&clone)
+{
+    auto tmp = mirror;
+    tmp += ".tmp";
+    fs::remove_all(tmp);
+    fs::create_directories(tmp.parent_path());
+    clone(tmp);
+    fs::rename(tmp, mirror);
+}
+
+static Strings git_mirror_args(const path &mirror, const Strings &args)
+{
+    Strings a{ "git", "--git-dir", mirror.string() };
+    a.insert(a.end(), args.begin(), args.end());
+    return a;
+}
+
+static String git_mirror_resolve(const path &mirror, const String &rev)
+{
+    Command c;
+    c.program = "git";
+    c.args = { "--git-dir", mirror.string(), "rev-parse", "--verify", rev + "^{commit}" };
+    c.execute();
+    return boost::trim_copy(c.out.text);
+}
+
 static int isEmpty(int64_t i)
 {
     return i == -1;
@@ -202,43 +271,34 @@ Git::Git(const yaml &root, const String &name)
 
 void Git::download() const
 {
-    // try to speed up git downloads from github
-    // add more sites below
-    if (url.find("github.com") != url.npos)
+    // try to speed up git downloads with source archives
+    String archive_ref;
+    if (!tag.empty())
+        archive_ref = tag;
+    else if (!branch.empty())
+        archive_ref = branch;
+    else if (!commit.empty())
+        archive_ref = commit;
+
+    auto archive_url = get_archive_url(Settings::get_user_settings().archive_providers, url, archive_ref);
+    if (!archive_url.empty())
     {
-        auto github_url = url;
-
-        // remove possible .git suffix
-        String suffix = ".git";
-        if (github_url.rfind(suffix) == github_url.size() - suffix.size())
-            github_url.substr(0, github_url.size() - suffix.size());
-
-        String fn;
-        github_url += "/archive/";
-        if (!tag.empty())
-        {
-            github_url += make_archive_name(tag);
-            fn = make_archive_name("1");
-        }
-        else if (!branch.empty())
-        {
-            github_url += branch + ".zip"; // but use .zip for branches!
-            fn = "1.zip";
-        }
-        else if (!commit.empty())
-        {
-            github_url += commit + ".zip"; // but use .zip for branches!
-            fn = "1.zip";
-        }
-
         try
         {
-            download_and_unpack(github_url, fn);
+            auto t = get_time<std::chrono::milliseconds>([&archive_url]
+            {
+                // unique name, so concurrent downloads do not collide
+                download_and_unpack(archive_url, make_archive_name(get_temp_filename("dl").string()));
+            });
+            LOG_DEBUG(logger, "Downloaded " << archive_url << " in " << t << " ms");
             return;
         }
-        catch (...)
+        catch (HttpError &e)
         {
-            // go to usual git download
+            // no such archive, maybe it is not a hosted repository
+            if (e.http_code != 404)
+                throw;
+            LOG_DEBUG(logger, e.what() << ", cloning");
         }
     }
 
@@ -248,30 +308,64 @@ void Git::download() const
         return;
 #endif
 
-    downloadRepository([this]()
-    {
-        String branchPath = url.substr(url.find_last_of("/") + 1);
-        fs::create_directory(branchPath);
-        ScopedCurrentPath scp(current_thread_path() / branchPath);
+    auto start = Clock::now();
+    auto mirror = get_vcs_mirror_dir(getString(), url);
+    ScopedFileLock lck(get_vcs_mirror_lock(mirror));
 
-        Command::execute({ "git", "init" });
-        Command::execute({ "git", "remote", "add", "origin", url });
-        if (!tag.empty())
-        {
-            Command::execute({ "git", "fetch", "--depth", "1", "origin", "refs/tags/" + tag });
-            Command::execute({ "git", "reset", "--hard", "FETCH_HEAD" });
-        }
-        else if (!branch.empty())
+    String ref;
+    if (!tag.empty())
+        ref = "refs/tags/" + tag;
+    else if (!branch.empty())
+        ref = "refs/heads/" + branch;
+
+    downloadRepository([this, &mirror, &ref]()
+    {
+        if (!fs::exists(mirror / "HEAD"))
         {
-            Command::execute({ "git", "fetch", "--depth", "1", "origin", branch });
-            Command::execute({ "git", "reset", "--hard", "FETCH_HEAD" });
+            fs::create_directories(mirror);
+            Command::execute({ "git", "init", "--bare", mirror.string() });
+            // commits are fetched from the mirror by id
+            Command::execute(git_mirror_args(mirror, { "config", "uploadpack.allowAnySHA1InWant", "true" }));
         }
-        else if (!commit.empty())
+
+        // tags and commits do not move, so they are fetched only once
+        if (!tag.empty() && execute_ok(git_mirror_args(mirror, { "rev-parse", "-q", "--verify", ref + "^{commit}" })))
+            return;
+        if (!commit.empty() && execute_ok(git_mirror_args(mirror, { "cat-file", "-e", commit + "^{commit}" })))
+            return;
+
+        if (!ref.empty())
         {
-            Command::execute({ "git", "fetch" });
-            Command::execute({ "git", "checkout", commit });
+            Command::execute(git_mirror_args(mirror, { "fetch", "--depth", "1", url, "+" + ref + ":" + ref }));
+            return;
         }
+
+        // servers may not allow to fetch unadvertised (or abbreviated) commits,
+        // then the whole history is fetched
+        if (execute_ok(git_mirror_args(mirror, { "fetch", "--depth", "1", url, commit + ":refs/cppan/" + commit })))
+            return;
+        Strings args{ "fetch" };
+        if (fs::exists(mirror / "shallow"))
+            args.push_back("--unshallow");
+        args.insert(args.end(), { url, "+refs/heads/*:refs/heads/*", "+refs/tags/*:refs/tags/*" });
+        Command::execute(git_mirror_args(mirror, args));
     });
+    touch_vcs_mirror(mirror);
+
+    // worktree is fetched from the mirror without network
+    auto id = git_mirror_resolve(mirror, ref.empty() ? commit : ref);
+
+    String branchPath = url.substr(url.find_last_of("/") + 1);
+    fs::create_directory(branchPath);
+    ScopedCurrentPath scp(current_thread_path() / branchPath);
+
+    Command::execute({ "git", "init" });
+    Command::execute({ "git", "remote", "add", "origin", url });
+    Command::execute({ "git", "fetch", "--depth", "1", mirror.string(), id });
+    Command::execute({ "git", "reset", "--hard", "FETCH_HEAD" });
+
+    LOG_DEBUG(logger, "Cloned " << url << " in " <<
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() << " ms");
 }
 
 bool Git::isValid(String *error) const
@@ -394,22 +488,44 @@ Hg::Hg(const yaml &root, const String &name)
 
 void Hg::download() const
 {
-    downloadRepository([this]()
-    {
-        Command::execute({ "hg", "clone", url });
+    auto mirror = get_vcs_mirror_dir(getString(), url);
+    ScopedFileLock lck(get_vcs_mirror_lock(mirror));
 
-        String branchPath = url.substr(url.find_last_of("/") + 1);
-        ScopedCurrentPath scp(current_thread_path() / branchPath);
+    String rev;
+    if (!tag.empty())
+        rev = tag;
+    else if (!branch.empty())
+        rev = branch;
+    else if (!commit.empty())
+        rev = commit;
+    else if (revision != -1)
+        rev = std::to_string(revision);
 
-        if (!tag.empty())
-            Command::execute({ "hg", "update", tag });
-        else if (!branch.empty())
-            Command::execute({ "hg", "update", branch });
-        else if (!commit.empty())
-            Command::execute({ "hg", "update", commit });
-        else if (revision != -1)
-            Command::execute({ "hg", "update", std::to_string(revision) });
+    downloadRepository([this, &mirror, &rev]()
+    {
+        if (!fs::exists(mirror))
+        {
+            create_vcs_mirror(mirror, [this](const path &tmp)
+            {
+                Command::execute({ "hg", "clone", "--noupdate", url, tmp.string() });
+            });
+            return;
+        }
+
+        // branches move, others are pulled only when missing
+        if (branch.empty() && !rev.empty() &&
+            execute_ok({ "hg", "log", "-R", mirror.string(), "-r", rev, "--template", "." }))
+            return;
+        Command::execute({ "hg", "pull", "-R", mirror.string(), url });
     });
+    touch_vcs_mirror(mirror);
+
+    String branchPath = url.substr(url.find_last_of("/") + 1);
+    Strings args{ "hg", "clone" };
+    if (!rev.empty())
+        args.insert(args.end(), { "--updaterev", rev });
+    args.insert(args.end(), { mirror.string(), branchPath });
+    Command::execute(args);
 }
 
 bool Hg::isValid(String *error) const
@@ -520,18 +636,38 @@ Bzr::Bzr(const yaml &root, const String &name)
 
 void Bzr::download() const
 {
-    downloadRepository([this]()
-    {
-        Command::execute({ "bzr", "branch", url });
+    auto mirror = get_vcs_mirror_dir(getString(), url);
+    ScopedFileLock lck(get_vcs_mirror_lock(mirror));
 
-        String branchPath = url.substr(url.find_last_of("/") + 1);
-        ScopedCurrentPath scp(current_thread_path() / branchPath);
+    String rev;
+    if (!tag.empty())
+        rev = "tag:" + tag;
+    else if (revision != -1)
+        rev = std::to_string(revision);
 
-        if (!tag.empty())
-            Command::execute({ "bzr", "update", "-r", "tag:" + tag });
-        else if (revision != -1)
-            Command::execute({ "bzr", "update", "-r", std::to_string(revision) });
+    downloadRepository([this, &mirror, &rev]()
+    {
+        if (!fs::exists(mirror))
+        {
+            create_vcs_mirror(mirror, [this](const path &tmp)
+            {
+                Command::execute({ "bzr", "branch", "--no-tree", url, tmp.string() });
+            });
+            return;
+        }
+
+        if (!rev.empty() && execute_ok({ "bzr", "revision-info", "-d", mirror.string(), "-r", rev }))
+            return;
+        Command::execute({ "bzr", "pull", "--overwrite", "-d", mirror.string(), url });
     });
+    touch_vcs_mirror(mirror);
+
+    String branchPath = url.substr(url.find_last_of("/") + 1);
+    Strings args{ "bzr", "branch" };
+    if (!rev.empty())
+        args.insert(args.end(), { "-r", rev });
+    args.insert(args.end(), { mirror.string(), branchPath });
+    Command::execute(args);
 }
 
 bool Bzr::isValid(String *error) const
@@ -629,22 +765,43 @@ Fossil::Fossil(const yaml &root, const String &name)
 
 void Fossil::download() const
 {
-    downloadRepository([this]()
-    {
-        Command::execute({ "fossil", "clone", url, "temp.fossil" });
+    // fossil repository is a single file
+    auto mirror = get_vcs_mirror_dir(getString(), url);
+    ScopedFileLock lck(get_vcs_mirror_lock(mirror));
 
-        fs::create_directory("temp");
-        ScopedCurrentPath scp(current_thread_path() / "temp");
+    String rev;
+    if (!tag.empty())
+        rev = tag;
+    else if (!branch.empty())
+        rev = branch;
+    else if (!commit.empty())
+        rev = commit;
 
-        Command::execute({ "fossil", "open", "../temp.fossil" });
+    downloadRepository([this, &mirror, &rev]()
+    {
+        if (!fs::exists(mirror))
+        {
+            create_vcs_mirror(mirror, [this](const path &tmp)
+            {
+                Command::execute({ "fossil", "clone", url, tmp.string() });
+            });
+            return;
+        }
 
-        if (!tag.empty())
-            Command::execute({ "fossil", "update", tag });
-        else if (!branch.empty())
-            Command::execute({ "fossil", "update", branch });
-        else if (!commit.empty())
-            Command::execute({ "fossil", "update", commit });
+        if (branch.empty() && !rev.empty() &&
+            execute_ok({ "fossil", "info", rev, "-R", mirror.string() }))
+            return;
+        Command::execute({ "fossil", "pull", url, "-R", mirror.string() });
     });
+    touch_vcs_mirror(mirror);
+
+    fs::create_directory("temp");
+    ScopedCurrentPath scp(current_thread_path() / "temp");
+
+    Strings args{ "fossil", "open", mirror.string() };
+    if (!rev.empty())
+        args.push_back(rev);
+    Command::execute(args);
 }
 
 void Fossil::save(yaml &root, const String &name) const
@@ -1031,16 +1188,21 @@ void applyVersionToUrl(Source &source, const Version &v)
 
 void Svn::download() const
 {
-    downloadRepository([this]()
-    {
-        Command::execute({ "svn", "checkout", url + "/trunk"});
+    // svn has no local mirrors, so only the needed tree is exported
+    // instead of checking out trunk and switching
+    String u = url + "/trunk";
+    if (!tag.empty())
+        u = url + "/tags/" + tag;
+    else if (!branch.empty())
+        u = url + "/branches/" + branch;
 
-        if (!tag.empty())
-            Command::execute({ "svn", "sw", url + "/tags/" + tag}); //tag
-        else if (!branch.empty())
-            Command::execute({ "svn", "sw", url + "/branches/" + branch}); //branch
-        else if (revision != -1) 
-            Command::execute({ "svn", "up", "-r" + revision });
+    downloadRepository([&u, this]()
+    {
+        Strings args{ "svn", "export", "--force" };
+        if (revision != -1)
+            args.insert(args.end(), { "-r", std::to_string(revision) });
+        args.insert(args.end(), { u, "trunk" });
+        Command::execute(args);
     });
 }
 
@@ -273,3 +273,7 @@ void applyVersionToUrl(Source &source, const Version &v);
 
 bool isValidSourceUrl(const Source &source);
 
+// vcs mirrors are kept in <dir>/<vcs>/<url hash> and are locked while used
+path get_vcs_mirrors_dir();
+path get_vcs_mirror_lock(const path &mirror);
+
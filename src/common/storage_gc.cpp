@@ -0,0 +1,362 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage_gc.h"
+
+#include "database.h"
+#include "directories.h"
+#include "lock.h"
+#include "package_store.h"
+#include "settings.h"
+#include "source.h"
+
+#include <boost/interprocess/sync/file_lock.hpp>
+
+#include <primitives/executor.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include <primitives/log.h>
+//DECLARE_STATIC_LOGGER(logger, "storage_gc");
+
+#define STORAGE_GC_TIME_FILE "storage_gc.time"
+#define STORAGE_GC_INTERVAL_HOURS 24
+
+struct StorageItem
+{
+    // package, config (hash) or vcs mirror
+    Package pkg;
+    String config;
+    path mirror;
+
+    TimePoint last_use;
+    uintmax_t size = 0;
+
+    bool is_config() const { return !config.empty(); }
+    bool is_mirror() const { return !mirror.empty(); }
+};
+
+static std::vector<path> get_config_dirs(const String &config)
+{
+    return {
+        directories.storage_dir_bin / config,
+        directories.storage_dir_cfg / config,
+        directories.storage_dir_exp / config,
+        directories.storage_dir_lib / config,
+#ifdef _WIN32
+        directories.storage_dir_lnk / config,
+#endif
+    };
+}
+
+static bool is_locked(const path &fn)
+{
+    boost::system::error_code ec;
+    if (!fs::exists(fn, ec))
+        return false;
+    try
+    {
+        boost::interprocess::file_lock lock(fn.string().c_str());
+        if (!lock.try_lock())
+            return true;
+        lock.unlock();
+    }
+    catch (std::exception &)
+    {
+        // be conservative
+        return true;
+    }
+    return false;
+}
+
+// locks are held by generate.cmake and build.cmake
+static bool is_build_dir_locked(const path &d)
+{
+    return is_locked(d / "cppan_generate.lock") || is_locked(d / "cppan_build.lock");
+}
+
+static bool has_locked_build_dirs(const Package &pkg)
+{
+    auto d = pkg.getDirObj() / "build";
+    boost::system::error_code ec;
+    if (!fs::exists(d, ec))
+        return false;
+    for (auto &f : boost::make_iterator_range(fs::directory_iterator(d, ec), {}))
+    {
+        if (fs::is_directory(f) && is_build_dir_locked(f))
+            return true;
+    }
+    return false;
+}
+
+static TimePoint get_last_write_time(const path &p)
+{
+    boost::system::error_code ec;
+    auto t = fs::last_write_time(p, ec);
+    if (ec)
+        return TimePoint();
+    return Clock::from_time_t(t);
+}
+
+template <class F>
+static void run_parallel(const std::vector<StorageItem *> &items, F &&f)
+{
+    auto &e = getExecutor();
+    std::vector<Future<void>> futures;
+    for (auto i : items)
+        futures.push_back(e.push([i, &f] { f(*i); }));
+    for (auto &fut : futures)
+        fut.wait();
+    for (auto &fut : futures)
+        fut.get();
+}
+
+static std::vector<StorageItem> get_storage_items()
+{
+    auto &sdb = getServiceDatabase();
+    auto pkgs_last_use = sdb.getPackagesLastUse();
+    auto configs_last_use = sdb.getConfigsLastUse();
+
+    std::vector<StorageItem> items;
+    for (auto &pkg : sdb.getInstalledPackages())
+    {
+        StorageItem i;
+        i.pkg = pkg;
+        auto lu = pkgs_last_use.find(pkg);
+        if (lu != pkgs_last_use.end())
+            i.last_use = lu->second;
+        else
+            i.last_use = get_last_write_time(pkg.getStampFilename());
+        items.push_back(i);
+    }
+
+    // configs used through cmake only are not registered in db,
+    // so we take modification time of their dirs
+    if (fs::exists(directories.storage_dir_cfg))
+    {
+        for (auto &f : boost::make_iterator_range(fs::directory_iterator(directories.storage_dir_cfg), {}))
+        {
+            if (!fs::is_directory(f))
+                continue;
+            StorageItem i;
+            i.config = f.path().filename().string();
+            auto lu = configs_last_use.find(i.config);
+            if (lu != configs_last_use.end())
+                i.last_use = lu->second;
+            else
+                i.last_use = get_last_write_time(f);
+            items.push_back(i);
+        }
+    }
+
+    // mirrors are touched on every use
+    auto mirrors = get_vcs_mirrors_dir();
+    if (fs::exists(mirrors))
+    {
+        for (auto &v : boost::make_iterator_range(fs::directory_iterator(mirrors), {}))
+        {
+            if (!fs::is_directory(v))
+                continue;
+            for (auto &f : boost::make_iterator_range(fs::directory_iterator(v), {}))
+            {
+                // fossil mirrors are files; unfinished clones (.tmp)
+                // and sqlite journals (-journal, -wal) are skipped
+                if (f.path().filename().string().find_first_of(".-") != String::npos ||
+                    !(fs::is_directory(f) || fs::is_regular_file(f)))
+                    continue;
+                StorageItem i;
+                i.mirror = f.path();
+                i.last_use = get_last_write_time(f);
+                items.push_back(i);
+            }
+        }
+    }
+
+    std::vector<StorageItem *> pitems;
+    for (auto &i : items)
+        pitems.push_back(&i);
+    run_parallel(pitems, [](auto &i)
+    {
+        if (i.is_config())
+        {
+            for (auto &d : get_config_dirs(i.config))
+                i.size += get_directory_size(d);
+            return;
+        }
+        if (i.is_mirror())
+        {
+            boost::system::error_code ec;
+            if (fs::is_regular_file(i.mirror, ec))
+            {
+                auto sz = fs::file_size(i.mirror, ec);
+                if (!ec)
+                    i.size += sz;
+            }
+            else
+                i.size += get_directory_size(i.mirror);
+            return;
+        }
+        i.size += get_directory_size(i.pkg.getDirSrc());
+        i.size += get_directory_size(i.pkg.getDirObj());
+    });
+
+    return items;
+}
+
+void storage_gc(uintmax_t budget)
+{
+    LOG_INFO(logger, "Collecting storage garbage...");
+
+    auto items = get_storage_items();
+
+    uintmax_t total = 0;
+    for (auto &i : items)
+        total += i.size;
+
+    LOG_INFO(logger, "Storage size: " << total / 1_MB << " MB, budget: " << budget / 1_MB << " MB");
+    if (total <= budget)
+        return;
+
+    std::sort(items.begin(), items.end(), [](const auto &i1, const auto &i2)
+    {
+        return i1.last_use < i2.last_use;
+    });
+
+    std::vector<StorageItem *> pkgs, configs, mirrors;
+    uintmax_t planned = 0;
+    for (auto &i : items)
+    {
+        if (total - planned <= budget)
+            break;
+        // never touch packages of the current run
+        if (!i.is_config() && !i.is_mirror() && rd.find(i.pkg) != rd.end())
+            continue;
+        if (i.is_mirror())
+            mirrors.push_back(&i);
+        else
+            (i.is_config() ? configs : pkgs).push_back(&i);
+        planned += i.size;
+    }
+
+    std::atomic<uintmax_t> freed{ 0 };
+    std::atomic_int n_pkgs{ 0 };
+    std::atomic_int n_configs{ 0 };
+    std::atomic_int n_mirrors{ 0 };
+
+    run_parallel(pkgs, [&freed, &n_pkgs](auto &i)
+    {
+        try
+        {
+            // same lock as on download, so no one could use the package while we're removing it
+            ScopedFileLock lck(i.pkg.getStampFilename(), std::defer_lock);
+            if (!lck.try_lock() || has_locked_build_dirs(i.pkg))
+            {
+                LOG_DEBUG(logger, "Skipping locked package: " << i.pkg.target_name);
+                return;
+            }
+
+            cleanPackages(PackagesSet{ i.pkg }, CleanTarget::All);
+
+            // clean does not remove obj dir completely
+            boost::system::error_code ec;
+            fs::remove_all(i.pkg.getDirObj(), ec);
+            fs::remove(i.pkg.getStampFilename(), ec);
+            fs::remove(i.pkg.getConfigCacheFilename(), ec);
+
+            freed += i.size;
+            n_pkgs++;
+        }
+        catch (std::exception &e)
+        {
+            LOG_WARN(logger, "Cannot remove package " << i.pkg.target_name << ": " << e.what());
+        }
+    });
+
+    // configs go after packages, because their cleaning walks obj dirs of installed packages
+    auto installed = getServiceDatabase().getInstalledPackages();
+    run_parallel(configs, [&freed, &n_configs, &installed](auto &i)
+    {
+        try
+        {
+            for (auto &pkg : installed)
+            {
+                if (is_build_dir_locked(pkg.getDirObj() / "build" / i.config))
+                {
+                    LOG_DEBUG(logger, "Skipping locked config: " << i.config);
+                    return;
+                }
+            }
+
+            cleanConfig(i.config);
+
+            freed += i.size;
+            n_configs++;
+        }
+        catch (std::exception &e)
+        {
+            LOG_WARN(logger, "Cannot remove config " << i.config << ": " << e.what());
+        }
+    });
+
+    run_parallel(mirrors, [&freed, &n_mirrors](auto &i)
+    {
+        try
+        {
+            // same lock as on fetch
+            ScopedFileLock lck(get_vcs_mirror_lock(i.mirror), std::defer_lock);
+            if (!lck.try_lock())
+            {
+                LOG_DEBUG(logger, "Skipping locked vcs mirror: " << i.mirror.string());
+                return;
+            }
+
+            fs::remove_all(i.mirror);
+
+            freed += i.size;
+            n_mirrors++;
+        }
+        catch (std::exception &e)
+        {
+            LOG_WARN(logger, "Cannot remove vcs mirror " << i.mirror.string() << ": " << e.what());
+        }
+    });
+
+    LOG_INFO(logger, "Removed " << n_pkgs << " package(s), " << n_configs << " config(s) and " << n_mirrors << " vcs mirror(s), freed " << freed / 1_MB << " MB");
+}
+
+void storage_gc_auto()
+{
+    auto budget = Settings::get_user_settings().storage_gc_budget_mb;
+    if (budget <= 0)
+        return;
+
+    auto fn = directories.storage_dir_etc / STORAGE_GC_TIME_FILE;
+    String ts = "0";
+    if (fs::exists(fn))
+        ts = read_file(fn);
+    auto tp = Clock::from_time_t(std::stoll(ts));
+    if (Clock::now() - tp < std::chrono::hours(STORAGE_GC_INTERVAL_HOURS))
+        return;
+
+    // only one process at a time, others just skip it
+    ScopedFileLock lck(get_lock("storage_gc"), std::defer_lock);
+    if (!lck.try_lock())
+        return;
+
+    write_file(fn, std::to_string(Clock::to_time_t(Clock::now())));
+    storage_gc(budget * 1_MB);
+}
@@ -17,9 +17,21 @@
 #include "yaml.h"
 
 #include "checks.h"
+#include "hash.h"
 #include "project.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstring>
+
+#include <primitives/log.h>
+//DECLARE_STATIC_LOGGER(logger, "yaml");
+
+// increase when format or prepare_config_for_reading() changes
+#define YAML_CACHE_VERSION 1
+#define YAML_CACHE_MAGIC "CPPANYML"
 
 void prepare_config_for_reading(yaml &root)
 {
@@ -92,6 +104,193 @@ yaml load_yaml_config(const String &s)
     return root;
 }
 
+namespace
+{
+
+enum class CachedNodeType : uint8_t
+{
+    Null,
+    Scalar,
+    Sequence,
+    Map,
+};
+
+void write_u32(String &out, uint32_t v)
+{
+    out.append((const char *)&v, sizeof(v));
+}
+
+void write_string(String &out, const String &s)
+{
+    write_u32(out, (uint32_t)s.size());
+    out += s;
+}
+
+void write_node(String &out, const yaml &n)
+{
+    switch (n.Type())
+    {
+    case YAML::NodeType::Scalar:
+        out += (char)CachedNodeType::Scalar;
+        write_string(out, n.Scalar());
+        break;
+    case YAML::NodeType::Sequence:
+        out += (char)CachedNodeType::Sequence;
+        write_u32(out, (uint32_t)n.size());
+        for (const auto &v : n)
+            write_node(out, v);
+        break;
+    case YAML::NodeType::Map:
+        out += (char)CachedNodeType::Map;
+        write_u32(out, (uint32_t)n.size());
+        for (const auto &kv : n)
+        {
+            write_node(out, kv.first);
+            write_node(out, kv.second);
+        }
+        break;
+    default:
+        out += (char)CachedNodeType::Null;
+        break;
+    }
+}
+
+struct CacheReader
+{
+    const char *p;
+    const char *end;
+
+    void check(size_t n) const
+    {
+        if ((size_t)(end - p) < n)
+            throw std::runtime_error("Unexpected end of yaml cache");
+    }
+
+    uint32_t u32()
+    {
+        uint32_t v;
+        check(sizeof(v));
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return v;
+    }
+
+    String string()
+    {
+        auto n = u32();
+        check(n);
+        String s(p, n);
+        p += n;
+        return s;
+    }
+
+    yaml node()
+    {
+        check(1);
+        auto t = (CachedNodeType)*p++;
+        switch (t)
+        {
+        case CachedNodeType::Null:
+            return yaml(YAML::NodeType::Null);
+        case CachedNodeType::Scalar:
+            return yaml(string());
+        case CachedNodeType::Sequence:
+        {
+            yaml n(YAML::NodeType::Sequence);
+            auto sz = u32();
+            while (sz--)
+                n.push_back(node());
+            return n;
+        }
+        case CachedNodeType::Map:
+        {
+            yaml n(YAML::NodeType::Map);
+            auto sz = u32();
+            while (sz--)
+            {
+                auto k = node();
+                n[k] = node();
+            }
+            return n;
+        }
+        }
+        throw std::runtime_error("Bad node type in yaml cache");
+    }
+};
+
+String cache_header(const String &hash)
+{
+    String h = YAML_CACHE_MAGIC;
+    write_u32(h, YAML_CACHE_VERSION);
+    write_string(h, hash);
+    return h;
+}
+
+bool read_yaml_cache(const path &cache_fn, const String &header, yaml &root)
+{
+    namespace bip = boost::interprocess;
+
+    boost::system::error_code ec;
+    if (!fs::exists(cache_fn, ec) || fs::file_size(cache_fn, ec) <= header.size())
+        return false;
+
+    try
+    {
+        bip::file_mapping m(cache_fn.string().c_str(), bip::read_only);
+        bip::mapped_region r(m, bip::read_only);
+        auto b = (const char *)r.get_address();
+        // other version or other file contents
+        if (memcmp(b, header.data(), header.size()) != 0)
+            return false;
+        CacheReader cr{ b + header.size(), b + r.get_size() };
+        root = cr.node();
+    }
+    catch (std::exception &e)
+    {
+        LOG_DEBUG(logger, "Cannot read yaml cache " << cache_fn.string() << ": " << e.what());
+        return false;
+    }
+    return true;
+}
+
+void write_yaml_cache(const path &cache_fn, const String &header, const yaml &root)
+{
+    // other processes could read it at the same time
+    auto tmp = cache_fn;
+    tmp += "." + fs::unique_path().string();
+    try
+    {
+        String data = header;
+        write_node(data, root);
+
+        fs::create_directories(cache_fn.parent_path());
+        write_file(tmp, data);
+        fs::rename(tmp, cache_fn);
+    }
+    catch (std::exception &e)
+    {
+        LOG_DEBUG(logger, "Cannot write yaml cache " << cache_fn.string() << ": " << e.what());
+        boost::system::error_code ec;
+        fs::remove(tmp, ec);
+    }
+}
+
+}
+
+yaml load_yaml_config(const path &p, const path &cache_fn)
+{
+    auto s = read_file(p);
+    auto header = cache_header(sha256_counted(s));
+
+    yaml root;
+    if (read_yaml_cache(cache_fn, header, root))
+        return root;
+
+    root = load_yaml_config(s);
+    write_yaml_cache(cache_fn, header, root);
+    return root;
+}
+
 void dump_yaml_config(const path &p, const yaml &root)
 {
     write_file(p, dump_yaml_config(root));
@@ -22,6 +22,8 @@
 
 yaml load_yaml_config(const path &p);
 yaml load_yaml_config(const String &s);
+// uses binary cache of the prepared tree when the file is not changed
+yaml load_yaml_config(const path &p, const path &cache_fn);
 
 void dump_yaml_config(const path &p, const yaml &root);
 String dump_yaml_config(const yaml &root);
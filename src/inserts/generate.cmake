@@ -37,6 +37,145 @@ if (NOT EXISTS ${import} OR
     # this check works when newer cmake version is available
     (EXISTS ${build_dir}/CMakeFiles AND NOT EXISTS ${to})
     )
+    set(generator ${CMAKE_GENERATOR})
+    #find_program(ninja ninja)
+    #if (NOT "${ninja}" STREQUAL "ninja-NOTFOUND")
+    #if (NINJA)
+    #    set(generator Ninja)
+    #endif()
+
+    # copy cmake cache for faster bootstrapping
+    set(from)
+    if (EXECUTABLE)
+        # TODO: fix executables bootstrapping
+        # BUG: copying bad cmake config dirs (32 - 64 bits)
+        #set(from ${storage_dir_cfg}/${config_dir}/CMakeFiles/${CMAKE_VERSION})
+    else()
+        set(from ${CMAKE_BINARY_DIR}/CMakeFiles/${CMAKE_VERSION})
+    endif()
+
+    # prepare variables for child process
+    set(OUTPUT_DIR ${config}) # ???
+
+    if (NOT CPPAN_COMMAND)
+        message(FATAL_ERROR "cppan command '${CPPAN_COMMAND}' not found - ${CMAKE_CURRENT_LIST_FILE} - ${target}")
+    endif()
+
+    set(toolset)
+    if (CMAKE_GENERATOR_TOOLSET)
+        set(toolset "-T${CMAKE_GENERATOR_TOOLSET}")
+    endif()
+
+    if (VISUAL_STUDIO_ACCELERATE_CLANG)
+        # speedup builds
+        set(generator Ninja)
+        set(toolset)
+    endif()
+
+    set(linker)
+    # if WIN32? if MSVC? everywhere?
+    if (WIN32 AND (VISUAL_STUDIO_ACCELERATE_CLANG OR NINJA))
+        # dont forget to pass linker with ninja!
+        set(linker "-DCMAKE_LINKER=${CMAKE_LINKER}")
+    endif()
+
+    set(sysver)
+    if (CMAKE_SYSTEM_VERSION AND (WIN32 OR APPLE)) # apple too?
+        set(sysver -DCMAKE_SYSTEM_VERSION=${CMAKE_SYSTEM_VERSION})
+    endif()
+
+    #
+    clear_variables(GEN_CHILD_VARS)
+    if (NOT EXECUTABLE)
+        add_variable(GEN_CHILD_VARS CMAKE_BUILD_TYPE)
+    endif()
+    add_variable(GEN_CHILD_VARS OUTPUT_DIR)
+    add_variable(GEN_CHILD_VARS CPPAN_BUILD_SHARED_LIBS)
+    # if turned on, build exe with the same config (arch, toolchain, generator etc.)
+    # do not pass this further, only projects with this option enabled will get it
+    #add_variable(GEN_CHILD_VARS CPPAN_BUILD_EXECUTABLES_WITH_SAME_CONFIG)
+    # if turned on, build exe with the same configiguration (debug, relwithdebinfo etc.)
+    add_variable(GEN_CHILD_VARS CPPAN_BUILD_EXECUTABLES_WITH_SAME_CONFIGURATION)
+    add_variable(GEN_CHILD_VARS CPPAN_COMMAND)
+    if (NOT EXECUTABLE)
+        add_variable(GEN_CHILD_VARS CPPAN_MT_BUILD) # not for exe
+    endif()
+    add_variable(GEN_CHILD_VARS CPPAN_CMAKE_VERBOSE)
+    add_variable(GEN_CHILD_VARS CPPAN_DEBUG_STACK_SPACE)
+    add_variable(GEN_CHILD_VARS CPPAN_BUILD_VERBOSE)
+    add_variable(GEN_CHILD_VARS CPPAN_BUILD_WARNING_LEVEL)
+    add_variable(GEN_CHILD_VARS CPPAN_COPY_ALL_LIBRARIES_TO_OUTPUT)
+    add_variable(GEN_CHILD_VARS XCODE)
+    add_variable(GEN_CHILD_VARS VISUAL_STUDIO)
+    add_variable(GEN_CHILD_VARS NINJA)
+    add_variable(GEN_CHILD_VARS NINJA_FOUND)
+    add_variable(GEN_CHILD_VARS CLANG)
+    #
+
+    # cmake arguments
+    set(generate_args -H${current_dir} -B${build_dir})
+    if (EXECUTABLE)# AND NOT CPPAN_BUILD_EXECUTABLES_WITH_SAME_CONFIG)
+        # build with the same compiler, generator and linker (in some cases)
+        list(APPEND generate_args
+            -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER}
+            -DCMAKE_CXX_COMPILER=${CMAKE_CXX_COMPILER}
+            ${linker}
+            -DVARIABLES_FILE=${variables_file}
+            -G "${generator}"
+        )
+    elseif (CMAKE_TOOLCHAIN_FILE)
+        list(APPEND generate_args
+            -DCMAKE_TOOLCHAIN_FILE=${CMAKE_TOOLCHAIN_FILE}
+            -DCMAKE_MAKE_PROGRAM=${CMAKE_MAKE_PROGRAM}
+            -G "${generator}"
+            -DVARIABLES_FILE=${variables_file}
+            ${sysver}
+        )
+    else()
+        list(APPEND generate_args
+            -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER}
+            -DCMAKE_CXX_COMPILER=${CMAKE_CXX_COMPILER}
+            ${linker}
+            -G "${generator}"
+            ${toolset}
+            -DVARIABLES_FILE=${variables_file}
+            ${sysver}
+        )
+    endif()
+
+    # links to solution files
+    # TODO: replace condition with if (VS generator)
+    set(target_lnk ${storage_dir_lnk}/${config_dir}/${target}.sln.lnk)
+    if (NOT VISUAL_STUDIO OR EXISTS ${target_lnk})
+        set(target_lnk)
+    endif()
+
+    # build trees are prepared by cppan in parallel (internal-generate-batch),
+    # here we only write down what to do
+    if (CPPAN_COLLECT_GENERATE)
+        get_property(visited GLOBAL PROPERTY CPPAN_GENERATE_VISITED_${build_dir})
+        if (NOT visited)
+            set_property(GLOBAL PROPERTY CPPAN_GENERATE_VISITED_${build_dir} 1)
+
+            write_variables_file(GEN_CHILD_VARS ${variables_file})
+            file(WRITE ${aliases_file} "${aliases}")
+
+            set(task "${target}\n${lock}\n${from}\n${to}\n${import}\n${import_fixed}\n${aliases_file}\n")
+            string(APPEND task "${target_lnk}\n${build_dir}/${package_hash_short}.sln\n${CMAKE_COMMAND}\n")
+            foreach(a ${generate_args})
+                string(APPEND task "${a}\n")
+            endforeach()
+            file(WRITE ${build_dir}.gen.task "${task}")
+        endif()
+        set(CPPAN_GENERATE_VISITED ${visited})
+
+        # parent must be prepared after this build tree
+        # (tab separated, paths may have spaces)
+        file(APPEND ${CPPAN_GENERATE_LIST} "${build_dir}\t${CPPAN_GENERATE_PARENT}\n")
+        set(CPPAN_GENERATE_PARENT ${build_dir})
+        return()
+    endif()
+
     file(
         LOCK ${lock}
         GUARD FILE # CMake bug workaround https://gitlab.kitware.com/cmake/cmake/issues/16295
@@ -67,24 +206,9 @@ if (NOT EXISTS ${import} OR
         (EXISTS ${build_dir}/CMakeFiles AND NOT EXISTS ${to})
         )
 
-        set(generator ${CMAKE_GENERATOR})
-        #find_program(ninja ninja)
-        #if (NOT "${ninja}" STREQUAL "ninja-NOTFOUND")
-        #if (NINJA)
-        #    set(generator Ninja)
-        #endif()
-
         # copy cmake cache for faster bootstrapping
         if (NOT EXISTS ${to})
-            if (EXECUTABLE)
-                # TODO: fix executables bootstrapping
-                # BUG: copying bad cmake config dirs (32 - 64 bits)
-                #set(from ${storage_dir_cfg}/${config_dir}/CMakeFiles/${CMAKE_VERSION})
-            else()
-                set(from ${CMAKE_BINARY_DIR}/CMakeFiles/${CMAKE_VERSION})
-            endif()
-
-            if (EXISTS ${from})
+            if (from AND EXISTS ${from})
                 execute_process(
                     COMMAND ${CMAKE_COMMAND} -E copy_directory ${from} ${to}
                     RESULT_VARIABLE ret
@@ -101,132 +225,18 @@ if (NOT EXISTS ${import} OR
             cppan_debug_message("To dir ${to}")
         endif()
 
-        # prepare variables for child process
-        set(OUTPUT_DIR ${config}) # ???
-
-        if (NOT CPPAN_COMMAND)
-            message(FATAL_ERROR "cppan command '${CPPAN_COMMAND}' not found - ${CMAKE_CURRENT_LIST_FILE} - ${target}")
-        endif()
-
-        set(toolset)
-        if (CMAKE_GENERATOR_TOOLSET)
-            set(toolset "-T${CMAKE_GENERATOR_TOOLSET}")
-        endif()
-
-        if (VISUAL_STUDIO_ACCELERATE_CLANG)
-            # speedup builds
-            set(generator Ninja)
-            set(toolset)
-        endif()
-
-        set(linker)
-        # if WIN32? if MSVC? everywhere?
-        if (WIN32 AND (VISUAL_STUDIO_ACCELERATE_CLANG OR NINJA))
-            # dont forget to pass linker with ninja!
-            set(linker "-DCMAKE_LINKER=${CMAKE_LINKER}")
-        endif()
-
-        if (CMAKE_SYSTEM_VERSION AND (WIN32 OR APPLE)) # apple too?
-            set(sysver -DCMAKE_SYSTEM_VERSION=${CMAKE_SYSTEM_VERSION})
-        endif()
-
-        #
-        clear_variables(GEN_CHILD_VARS)
-        if (NOT EXECUTABLE)
-            add_variable(GEN_CHILD_VARS CMAKE_BUILD_TYPE)
-        endif()
-        add_variable(GEN_CHILD_VARS OUTPUT_DIR)
-        add_variable(GEN_CHILD_VARS CPPAN_BUILD_SHARED_LIBS)
-        # if turned on, build exe with the same config (arch, toolchain, generator etc.)
-        # do not pass this further, only projects with this option enabled will get it
-        #add_variable(GEN_CHILD_VARS CPPAN_BUILD_EXECUTABLES_WITH_SAME_CONFIG)
-        # if turned on, build exe with the same configiguration (debug, relwithdebinfo etc.)
-        add_variable(GEN_CHILD_VARS CPPAN_BUILD_EXECUTABLES_WITH_SAME_CONFIGURATION)
-        add_variable(GEN_CHILD_VARS CPPAN_COMMAND)
-        if (NOT EXECUTABLE)
-            add_variable(GEN_CHILD_VARS CPPAN_MT_BUILD) # not for exe
-        endif()
-        add_variable(GEN_CHILD_VARS CPPAN_CMAKE_VERBOSE)
-        add_variable(GEN_CHILD_VARS CPPAN_DEBUG_STACK_SPACE)
-        add_variable(GEN_CHILD_VARS CPPAN_BUILD_VERBOSE)
-        add_variable(GEN_CHILD_VARS CPPAN_BUILD_WARNING_LEVEL)
-        add_variable(GEN_CHILD_VARS CPPAN_COPY_ALL_LIBRARIES_TO_OUTPUT)
-        add_variable(GEN_CHILD_VARS XCODE)
-        add_variable(GEN_CHILD_VARS VISUAL_STUDIO)
-        add_variable(GEN_CHILD_VARS NINJA)
-        add_variable(GEN_CHILD_VARS NINJA_FOUND)
-        add_variable(GEN_CHILD_VARS CLANG)
         write_variables_file(GEN_CHILD_VARS ${variables_file})
-        #
 
         #message(STATUS "")
         message(STATUS "Preparing build tree for ${target} (${config_unhashed} - ${config_dir} - ${generator})")
         #message(STATUS "")
 
         # call cmake
-        if (EXECUTABLE)# AND NOT CPPAN_BUILD_EXECUTABLES_WITH_SAME_CONFIG)
-                # build with the same compiler, generator and linker (in some cases)
-                cppan_debug_message("COMMAND ${CMAKE_COMMAND}
-                        -H${current_dir} -B${build_dir}
-                        -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER}
-                        -DCMAKE_CXX_COMPILER=${CMAKE_CXX_COMPILER}
-                        ${linker}
-                        -DVARIABLES_FILE=${variables_file}
-                        -G \"${generator}\""
-                )
-                execute_process(
-                    COMMAND ${CMAKE_COMMAND}
-                        -H${current_dir} -B${build_dir}
-                        -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER}
-                        -DCMAKE_CXX_COMPILER=${CMAKE_CXX_COMPILER}
-                        ${linker}
-                        -DVARIABLES_FILE=${variables_file}
-                        -G "${generator}"
-                    RESULT_VARIABLE ret
-                )
-        else()
-            if (CMAKE_TOOLCHAIN_FILE)
-                cppan_debug_message("COMMAND ${CMAKE_COMMAND}
-                        -H${current_dir} -B${build_dir}
-                        -DCMAKE_TOOLCHAIN_FILE=${CMAKE_TOOLCHAIN_FILE}
-                        -DCMAKE_MAKE_PROGRAM=${CMAKE_MAKE_PROGRAM}
-                        -G \"${generator}\"
-                        -DVARIABLES_FILE=${variables_file}
-                        ${sysver}"
-                )
-                execute_process(
-                    COMMAND ${CMAKE_COMMAND}
-                        -H${current_dir} -B${build_dir}
-                        -DCMAKE_TOOLCHAIN_FILE=${CMAKE_TOOLCHAIN_FILE}
-                        -DCMAKE_MAKE_PROGRAM=${CMAKE_MAKE_PROGRAM}
-                        -G "${generator}"
-                        -DVARIABLES_FILE=${variables_file}
-                        ${sysver}
-                    RESULT_VARIABLE ret
-                )
-            else(CMAKE_TOOLCHAIN_FILE)
-                cppan_debug_message("COMMAND ${CMAKE_COMMAND}
-                        -H${current_dir} -B${build_dir}
-                        -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER}
-                        -DCMAKE_CXX_COMPILER=${CMAKE_CXX_COMPILER}
-                        -G \"${generator}\"
-                        -DVARIABLES_FILE=${variables_file}
-                        ${sysver}"
-                )
-                execute_process(
-                    COMMAND ${CMAKE_COMMAND}
-                        -H${current_dir} -B${build_dir}
-                        -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER}
-                        -DCMAKE_CXX_COMPILER=${CMAKE_CXX_COMPILER}
-                        ${linker}
-                        -G "${generator}"
-                        ${toolset}
-                        -DVARIABLES_FILE=${variables_file}
-                        ${sysver}
-                    RESULT_VARIABLE ret
-                )
-            endif(CMAKE_TOOLCHAIN_FILE)
-        endif()
+        cppan_debug_message("COMMAND ${CMAKE_COMMAND} ${generate_args}")
+        execute_process(
+            COMMAND ${CMAKE_COMMAND} ${generate_args}
+            RESULT_VARIABLE ret
+        )
         check_result_variable(${ret})
 
         # fix imports
@@ -240,9 +250,7 @@ if (NOT EXISTS ${import} OR
         check_result_variable(${ret})
 
         # create links to solution files
-        # TODO: replace condition with if (VS generator)
-        set(target_lnk ${storage_dir_lnk}/${config_dir}/${target}.sln.lnk)
-        if (VISUAL_STUDIO AND NOT EXISTS ${target_lnk})
+        if (target_lnk)
             cppan_debug_message("COMMAND ${CPPAN_COMMAND} internal-create-link-to-solution ${build_dir} ${target_lnk}")
             execute_process(
                 COMMAND ${CPPAN_COMMAND} internal-create-link-to-solution ${build_dir}/${package_hash_short}.sln ${target_lnk}
@@ -255,6 +263,8 @@ if (NOT EXISTS ${import} OR
     endif()
 
     file(LOCK ${lock} RELEASE)
+elseif (CPPAN_COLLECT_GENERATE)
+    set(CPPAN_GENERATE_VISITED 1)
 endif()
 
 ################################################################################
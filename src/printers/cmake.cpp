@@ -451,12 +451,36 @@ void print_dependencies(CMakeContext &ctx, const Package &d, bool use_cache)
             ctx.addLine();
         }
 
-        for (auto &dep : includes)
+        auto print_includes = [&ctx, &includes]
         {
-            ScopedDependencyCondition sdc(ctx, dep);
-            ctx.addLine("# " + dep.target_name + "\n" +
-                "cppan_include(\"" + normalize_path(dep.getDirObj() / cmake_obj_generate_filename) + "\")");
-        }
+            for (auto &dep : includes)
+            {
+                ScopedDependencyCondition sdc(ctx, dep);
+                ctx.addLine("# " + dep.target_name + "\n" +
+                    "cppan_include(\"" + normalize_path(dep.getDirObj() / cmake_obj_generate_filename) + "\")");
+            }
+        };
+
+        // first, find all build trees to be prepared and let cppan prepare them in parallel,
+        // so nested configures are not serialized behind generate locks
+        ctx.if_("NOT CPPAN_COLLECT_GENERATE");
+        ctx.addLine("set(CPPAN_COLLECT_GENERATE 1)");
+        ctx.addLine("set(CPPAN_GENERATE_LIST ${CMAKE_CURRENT_BINARY_DIR}/cppan_generate.list)");
+        ctx.addLine("file(WRITE ${CPPAN_GENERATE_LIST} \"\")");
+        print_includes();
+        ctx.addLine("set(CPPAN_COLLECT_GENERATE 0)");
+        ctx.addLine("file(READ ${CPPAN_GENERATE_LIST} generate_list)");
+        ctx.if_("NOT \"${generate_list}\" STREQUAL \"\"");
+        ctx.addLine("execute_process(");
+        ctx.addLine("    COMMAND ${CPPAN_COMMAND} internal-generate-batch ${CPPAN_GENERATE_LIST}");
+        ctx.addLine("    RESULT_VARIABLE ret");
+        ctx.addLine(")");
+        ctx.addLine("check_result_variable(${ret})");
+        ctx.endif();
+        ctx.endif();
+        ctx.addLine();
+
+        print_includes();
 
         ctx.else_();
         ctx.addLine(boost::trim_copy(ctx2.getText()));
@@ -852,7 +876,7 @@ void CMakePrinter::print_copy_dependencies(CMakeContext &ctx, const String &targ
     {
         auto &p = dp.second;
 
-        p.conditions.insert(rd[p].config->getDefaultProject().condition);
+        p.conditions.insert(rd[p].config.getSummary().condition);
 
         if (p.flags[pfExecutable])
         {
@@ -1216,7 +1240,7 @@ endif()
         {
             if (!once)
             {
-                dep.second.conditions.insert(rd[dep.second].config->getDefaultProject().condition);
+                dep.second.conditions.insert(rd[dep.second].config.getSummary().condition);
                 ScopedDependencyCondition sdc(ctx, dep.second);
 
                 // this or selected project below
@@ -2643,7 +2667,22 @@ void CMakePrinter::print_obj_generate_file(const path &fn) const
 
     // executable (non-direct) is the last in the chain
     // we do not use its exported symbols or whatever
-    if (!(d.flags[pfExecutable] && !d.flags[pfDirectDependency]))
+    const bool import_deps = !(d.flags[pfExecutable] && !d.flags[pfDirectDependency]);
+
+    // only walk dependencies, their build trees are prepared later
+    config_section_title(ctx, "collect build trees");
+    ctx.if_("CPPAN_COLLECT_GENERATE");
+    if (import_deps)
+    {
+        ctx.if_("NOT CPPAN_GENERATE_VISITED");
+        ctx.addLine("cppan_include(${current_dir}/exports.cmake)");
+        ctx.endif();
+    }
+    ctx.addLine("return()");
+    ctx.endif();
+    ctx.addLine();
+
+    if (import_deps)
     {
         config_section_title(ctx, "import direct deps");
         ctx.addLine("cppan_include(${current_dir}/exports.cmake)");
@@ -2734,7 +2773,7 @@ void CMakePrinter::print_obj_export_file(const path &fn) const
         ScopedDependencyCondition sdc(ctx, dep);
         if (!dep.flags[pfHeaderOnly])
             ctx.addLine("cppan_include(\"" + normalize_path(b / cmake_obj_generate_filename) + "\")");
-        ctx.if_("NOT TARGET " + dep.target_name + "");
+        ctx.if_("NOT CPPAN_COLLECT_GENERATE AND NOT TARGET " + dep.target_name + "");
         if (dep.flags[pfHeaderOnly])
             add_subdirectory(ctx, dep.getDirSrc().string());
         else
@@ -2931,7 +2970,7 @@ add_dependencies()" + old_cppan_target + R"( run-cppan)
         {
             if (!dep.second.flags[pfLocalProject])
                 continue;
-            dep.second.conditions.insert(rd[dep.second].config->getDefaultProject().condition);
+            dep.second.conditions.insert(rd[dep.second].config.getSummary().condition);
             if (dep.second.flags[pfExecutable])
             {
                 ScopedDependencyCondition sdc(ctx, dep.second);
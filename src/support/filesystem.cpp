@@ -93,3 +93,24 @@ path findRootDirectory(const path &p)
     findRootDirectory1(p, root);
     return root;
 }
+
+uintmax_t get_directory_size(const path &p)
+{
+    uintmax_t size = 0;
+    boost::system::error_code ec;
+    if (!fs::exists(p, ec))
+        return size;
+    if (fs::is_regular_file(p, ec))
+        return fs::file_size(p, ec);
+    for (fs::recursive_directory_iterator i(p, ec), end; !ec && i != end; i.increment(ec))
+    {
+        // files may disappear while we walk
+        boost::system::error_code ec2;
+        if (!fs::is_regular_file(i->path(), ec2))
+            continue;
+        auto sz = fs::file_size(i->path(), ec2);
+        if (!ec2)
+            size += sz;
+    }
+    return size;
+}
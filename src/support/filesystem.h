@@ -23,6 +23,7 @@
 #define STAMPS_DIR "stamps"
 #define STORAGE_DIR "storage"
 #define CPPAN_FILENAME "cppan.yml"
+#define CPPAN_LOCK_FILENAME "cppan.lock"
 
 using Stamps = std::unordered_map<path, time_t>;
 using SourceGroups = std::map<String, std::set<String>>;
@@ -37,3 +38,6 @@ String get_stamp_filename(const String &prefix);
 String make_archive_name(const String &fn = String());
 
 path findRootDirectory(const path &p);
+
+// total size of regular files, missing dirs are 0
+uintmax_t get_directory_size(const path &p);
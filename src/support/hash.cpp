@@ -16,6 +16,21 @@
 
 #include "hash.h"
 
+#include <atomic>
+
+static std::atomic<uint64_t> sha256_count;
+
+String sha256_counted(const String &data)
+{
+    sha256_count++;
+    return sha256(data);
+}
+
+uint64_t get_sha256_count()
+{
+    return sha256_count;
+}
+
 String shorten_hash(const String &data)
 {
     return shorten_hash(data, CPPAN_CONFIG_HASH_SHORT_LENGTH);
@@ -23,7 +38,7 @@ String shorten_hash(const String &data)
 
 String sha256_short(const String &data)
 {
-    return shorten_hash(sha256(data));
+    return shorten_hash(sha256_counted(data));
 }
 
 String hash_config(const String &c)
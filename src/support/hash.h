@@ -21,6 +21,10 @@
 #define CPPAN_CONFIG_HASH_METHOD "SHA256"
 #define CPPAN_CONFIG_HASH_SHORT_LENGTH 8
 
+// same as sha256(), but calls are counted
+String sha256_counted(const String &data);
+uint64_t get_sha256_count();
+
 String shorten_hash(const String &data);
 String sha256_short(const String &data);
 String hash_config(const String &c);
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "http_session.h"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <curl/curl.h>
+
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+static size_t write_response(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    auto &s = *(std::string *)userdata;
+    s.append(ptr, size * nmemb);
+    return size * nmemb;
+}
+
+static int check_cancel(void *userdata, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+{
+    return *(const std::atomic_bool *)userdata ? 1 : 0;
+}
+
+HttpSession::HttpSession()
+{
+    curl = curl_easy_init();
+    if (!curl)
+        throw std::runtime_error("Cannot init curl");
+}
+
+HttpSession::~HttpSession()
+{
+    curl_easy_cleanup((CURL *)curl);
+}
+
+void HttpSession::setup(const HttpRequest &req, const std::atomic_bool *cancel)
+{
+    auto c = (CURL *)curl;
+
+    // options are reset, but connections are kept
+    curl_easy_reset(c);
+
+    curl_easy_setopt(c, CURLOPT_URL, req.url.c_str());
+    curl_easy_setopt(c, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(c, CURLOPT_TCP_KEEPALIVE, 1L);
+    if (cancel)
+    {
+        curl_easy_setopt(c, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(c, CURLOPT_XFERINFOFUNCTION, check_cancel);
+        curl_easy_setopt(c, CURLOPT_XFERINFODATA, cancel);
+    }
+    if (req.verbose)
+        curl_easy_setopt(c, CURLOPT_VERBOSE, 1L);
+    if (req.ignore_ssl_checks)
+    {
+        curl_easy_setopt(c, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(c, CURLOPT_SSL_VERIFYHOST, 0L);
+    }
+    if (!req.proxy.host.empty())
+    {
+        curl_easy_setopt(c, CURLOPT_PROXY, req.proxy.host.c_str());
+        if (!req.proxy.user.empty())
+            curl_easy_setopt(c, CURLOPT_PROXYUSERPWD, req.proxy.user.c_str());
+    }
+    if (req.connect_timeout > 0)
+        curl_easy_setopt(c, CURLOPT_CONNECTTIMEOUT, (long)req.connect_timeout);
+    if (req.timeout > 0)
+        curl_easy_setopt(c, CURLOPT_TIMEOUT, (long)req.timeout);
+}
+
+HttpSessionResponse HttpSession::request(const HttpRequest &req, const std::atomic_bool *cancel)
+{
+    auto c = (CURL *)curl;
+    setup(req, cancel);
+
+    HttpSessionResponse resp;
+    // all encodings supported by curl build (gzip, deflate, ...)
+    curl_easy_setopt(c, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, write_response);
+    curl_easy_setopt(c, CURLOPT_WRITEDATA, &resp.response);
+
+    curl_slist *headers = nullptr;
+    if (req.type == HttpRequest::Post)
+    {
+        headers = curl_slist_append(headers, "Content-Type: application/json");
+        curl_easy_setopt(c, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(c, CURLOPT_POSTFIELDS, req.data.c_str());
+        curl_easy_setopt(c, CURLOPT_POSTFIELDSIZE, (long)req.data.size());
+    }
+
+    auto res = curl_easy_perform(c);
+    curl_slist_free_all(headers);
+
+    long http_code = 0;
+    if (res == CURLE_OK)
+        curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &http_code);
+    else
+        resp.error = curl_easy_strerror(res);
+    resp.http_code = http_code;
+    return resp;
+}
+
+HttpSessionResponse HttpSession::request(const HttpRequest &req, int n_tries, const std::atomic_bool *cancel)
+{
+    HttpSessionResponse resp;
+    for (int i = 0; i < n_tries; i++)
+    {
+        if (i)
+            std::this_thread::sleep_for(get_backoff_delay(i - 1));
+        if (cancel && *cancel)
+            break;
+        resp = request(req, cancel);
+        if (resp.http_code != 0 && resp.http_code != 429 && resp.http_code < 500)
+            break;
+    }
+    return resp;
+}
+
+struct HeadersData
+{
+    String etag;
+    String last_modified;
+    bool accept_ranges = false;
+};
+
+struct DownloadData
+{
+    CURL *curl;
+    FILE *f;
+    uintmax_t offset;
+    uintmax_t limit;
+    uintmax_t ranges_min_size;
+    std::atomic<uintmax_t> *received;
+    const HeadersData *headers;
+    bool range = false;
+    bool checked = false;
+    bool range_ignored = false;
+    bool limit_exceeded = false;
+    bool large = false;
+};
+
+static size_t write_to_file(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+    auto &d = *(DownloadData *)userdata;
+    if (!d.checked)
+    {
+        d.checked = true;
+        if (d.range)
+        {
+            long http_code = 0;
+            curl_easy_getinfo(d.curl, CURLINFO_RESPONSE_CODE, &http_code);
+            // whole file is sent, or it was changed (If-Range)
+            if (http_code != 206)
+            {
+                d.range_ignored = true;
+                return 0;
+            }
+        }
+        curl_off_t size = -1;
+        curl_easy_getinfo(d.curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &size);
+        if (size >= 0)
+        {
+            if (d.limit && d.offset + size > d.limit)
+            {
+                d.limit_exceeded = true;
+                return 0;
+            }
+            if (d.ranges_min_size && d.headers->accept_ranges && (uintmax_t)size >= d.ranges_min_size)
+            {
+                d.large = true;
+                return 0;
+            }
+        }
+    }
+    auto n = size * nmemb;
+    if (d.limit && d.offset + n > d.limit)
+    {
+        d.limit_exceeded = true;
+        return 0;
+    }
+    if (fwrite(ptr, size, nmemb, d.f) != nmemb)
+        return 0;
+    d.offset += n;
+    if (d.received)
+        *d.received += n;
+    return n;
+}
+
+static size_t read_header(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+    auto &d = *(HeadersData *)userdata;
+    auto n = size * nitems;
+    String h(buffer, n);
+    // new response after redirect
+    if (h.compare(0, 5, "HTTP/") == 0)
+    {
+        d = HeadersData();
+        return n;
+    }
+    auto p = h.find(':');
+    if (p == h.npos)
+        return n;
+    auto name = boost::to_lower_copy(h.substr(0, p));
+    auto value = boost::trim_copy(h.substr(p + 1));
+    // weak etags cannot be used in If-Range
+    if (name == "etag" && value.compare(0, 2, "W/") != 0)
+        d.etag = value;
+    else if (name == "last-modified")
+        d.last_modified = value;
+    else if (name == "accept-ranges")
+        d.accept_ranges = value == "bytes";
+    return n;
+}
+
+static void set_file_info(CURL *c, CURLcode res, const HeadersData &h, HttpFileInfo &info)
+{
+    if (res == CURLE_OK || res == CURLE_HTTP_RETURNED_ERROR)
+        curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &info.http_code);
+    curl_off_t size = -1;
+    curl_easy_getinfo(c, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &size);
+    info.size = size;
+    info.accept_ranges = h.accept_ranges;
+    info.validator = h.etag.empty() ? h.last_modified : h.etag;
+}
+
+HttpFileInfo HttpSession::download(const HttpRequest &req, const path &fn, const HttpDownload &opts)
+{
+    auto c = (CURL *)curl;
+    setup(req, opts.cancel);
+
+    DownloadData d;
+    d.curl = c;
+    d.offset = opts.offset;
+    d.limit = opts.file_size_limit;
+    d.ranges_min_size = opts.ranges_min_size;
+    d.received = opts.received;
+    d.range = opts.offset || opts.last >= 0;
+    d.f = boost::nowide::fopen(fn.string().c_str(), opts.offset ? "ab" : "wb");
+    if (!d.f)
+        throw std::runtime_error("Cannot open file: " + fn.string());
+
+    HeadersData h;
+    d.headers = &h;
+    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, write_to_file);
+    curl_easy_setopt(c, CURLOPT_WRITEDATA, &d);
+    curl_easy_setopt(c, CURLOPT_HEADERFUNCTION, read_header);
+    curl_easy_setopt(c, CURLOPT_HEADERDATA, &h);
+    // do not write error pages into the file
+    curl_easy_setopt(c, CURLOPT_FAILONERROR, 1L);
+
+    String range;
+    curl_slist *headers = nullptr;
+    if (d.range)
+    {
+        range = std::to_string(opts.offset) + "-";
+        if (opts.last >= 0)
+            range += std::to_string(opts.last);
+        curl_easy_setopt(c, CURLOPT_RANGE, range.c_str());
+        if (opts.offset && !opts.validator.empty())
+        {
+            headers = curl_slist_append(headers, ("If-Range: " + opts.validator).c_str());
+            curl_easy_setopt(c, CURLOPT_HTTPHEADER, headers);
+        }
+    }
+
+    auto res = curl_easy_perform(c);
+    fclose(d.f);
+    curl_slist_free_all(headers);
+
+    // continue is not possible, start from the beginning
+    if (d.range_ignored && opts.last < 0)
+    {
+        auto o = opts;
+        o.offset = 0;
+        return download(req, fn, o);
+    }
+
+    HttpFileInfo info;
+    set_file_info(c, res, h, info);
+    if (d.range_ignored)
+        info.http_code = 200;
+    info.size_limit_exceeded = d.limit_exceeded;
+    info.large = d.large;
+    return info;
+}
+
+HttpSession &getHttpSession()
+{
+    thread_local HttpSession s;
+    return s;
+}
+
+std::chrono::milliseconds get_backoff_delay(int attempt, std::chrono::milliseconds base, std::chrono::milliseconds cap)
+{
+    thread_local std::mt19937 g(std::random_device{}());
+    auto max = base.count() << std::min(attempt, 20);
+    if (max > cap.count())
+        max = cap.count();
+    return std::chrono::milliseconds(std::uniform_int_distribution<long long>(0, max)(g));
+}
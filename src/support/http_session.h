@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <primitives/filesystem.h>
+#include <primitives/http.h>
+
+#include <atomic>
+#include <chrono>
+
+struct HttpFileInfo
+{
+    long http_code = 0;
+    int64_t size = -1; // of the response body
+    bool accept_ranges = false;
+    // etag or last modified date
+    String validator;
+    // transfer is stopped, http_code is 0
+    bool size_limit_exceeded = false;
+    bool large = false; // see HttpDownload::ranges_min_size
+};
+
+struct HttpSessionResponse : HttpResponse
+{
+    // transport error text, set when http_code is 0
+    String error;
+};
+
+struct HttpDownload
+{
+    // file already has bytes before this one, transfer continues from here
+    uintmax_t offset = 0;
+    // last byte of requested range, -1 - up to the end
+    int64_t last = -1;
+    // when set, range is sent only if file was not changed
+    String validator;
+    uintmax_t file_size_limit = 0;
+    // transfer is stopped before the body, when server accepts ranges
+    // and response is not smaller (so caller can use several ranges)
+    uintmax_t ranges_min_size = 0;
+    const std::atomic_bool *cancel = nullptr;
+    // bytes written to the file, updated during transfer
+    std::atomic<uintmax_t> *received = nullptr;
+};
+
+// Keeps the connection open between requests to the same server
+// (curl reuses connections of the same handle).
+// Responses are requested compressed, downloads are not
+// (archives are compressed already, and ranges must match the file).
+// Not thread safe, use one session per thread (see getHttpSession()).
+class HttpSession
+{
+public:
+    HttpSession();
+    HttpSession(const HttpSession &) = delete;
+    HttpSession &operator=(const HttpSession &) = delete;
+    ~HttpSession();
+
+    // when cancel is set, transfer is aborted and http_code is 0
+    HttpSessionResponse request(const HttpRequest &req, const std::atomic_bool *cancel = nullptr);
+
+    // retries connection errors and server errors (5xx, 429)
+    // with exponential backoff and jitter
+    HttpSessionResponse request(const HttpRequest &req, int n_tries, const std::atomic_bool *cancel = nullptr);
+
+    // When range cannot be used, the whole file is downloaded,
+    // but for requests with the last byte set only http_code 200 is returned.
+    // http_code is 0 when transfer is interrupted.
+    HttpFileInfo download(const HttpRequest &req, const path &fn, const HttpDownload &opts);
+
+private:
+    void *curl;
+
+    void setup(const HttpRequest &req, const std::atomic_bool *cancel);
+};
+
+HttpSession &getHttpSession();
+
+// full jitter: random delay in [0, min(cap, base * 2^attempt)]
+std::chrono::milliseconds get_backoff_delay(int attempt,
+    std::chrono::milliseconds base = std::chrono::milliseconds(250),
+    std::chrono::milliseconds cap = std::chrono::seconds(8));
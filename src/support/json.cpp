@@ -0,0 +1,544 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "json.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#define JSON_MAX_DEPTH 512
+
+class JsonParser
+{
+public:
+    JsonParser(const String &s)
+        : begin(s.data()), p(s.data()), end(s.data() + s.size())
+    {
+    }
+
+    JsonValue parse()
+    {
+        JsonValue v;
+        skipSpaces();
+        parseValue(v, 0);
+        skipSpaces();
+        if (p != end)
+            error("unexpected data after the value");
+        return v;
+    }
+
+private:
+    const char *begin;
+    const char *p;
+    const char *end;
+
+    [[noreturn]] void error(const String &msg) const
+    {
+        throw std::runtime_error("json: " + msg + " at offset " + std::to_string(p - begin));
+    }
+
+    void skipSpaces()
+    {
+        while (p != end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+            p++;
+    }
+
+    void expect(char c)
+    {
+        if (p == end || *p != c)
+            error(String("expected '") + c + "'");
+        p++;
+    }
+
+    void expectWord(const char *w)
+    {
+        auto n = strlen(w);
+        if ((size_t)(end - p) < n || strncmp(p, w, n) != 0)
+            error("unexpected token");
+        p += n;
+    }
+
+    void parseValue(JsonValue &v, int depth)
+    {
+        if (depth > JSON_MAX_DEPTH)
+            error("too deep nesting");
+        if (p == end)
+            error("unexpected end of data");
+        switch (*p)
+        {
+        case '{':
+            parseObject(v, depth);
+            break;
+        case '[':
+            parseArray(v, depth);
+            break;
+        case '"':
+            v.type = JsonValue::Type::String;
+            parseString(v.value);
+            break;
+        case 't':
+            expectWord("true");
+            v.type = JsonValue::Type::Boolean;
+            v.value = "true";
+            break;
+        case 'f':
+            expectWord("false");
+            v.type = JsonValue::Type::Boolean;
+            v.value = "false";
+            break;
+        case 'n':
+            expectWord("null");
+            v.type = JsonValue::Type::Null;
+            break;
+        default:
+            parseNumber(v);
+            break;
+        }
+    }
+
+    void parseObject(JsonValue &v, int depth)
+    {
+        v.type = JsonValue::Type::Object;
+        p++;
+        skipSpaces();
+        if (p != end && *p == '}')
+        {
+            p++;
+            return;
+        }
+        while (1)
+        {
+            skipSpaces();
+            v.object.emplace_back();
+            auto &m = v.object.back();
+            parseString(m.first);
+            skipSpaces();
+            expect(':');
+            skipSpaces();
+            parseValue(m.second, depth + 1);
+            skipSpaces();
+            if (p != end && *p == ',')
+            {
+                p++;
+                continue;
+            }
+            expect('}');
+            break;
+        }
+    }
+
+    void parseArray(JsonValue &v, int depth)
+    {
+        v.type = JsonValue::Type::Array;
+        p++;
+        skipSpaces();
+        if (p != end && *p == ']')
+        {
+            p++;
+            return;
+        }
+        while (1)
+        {
+            skipSpaces();
+            v.array.emplace_back();
+            parseValue(v.array.back(), depth + 1);
+            skipSpaces();
+            if (p != end && *p == ',')
+            {
+                p++;
+                continue;
+            }
+            expect(']');
+            break;
+        }
+    }
+
+    void parseNumber(JsonValue &v)
+    {
+        auto b = p;
+        if (p != end && *p == '-')
+            p++;
+        auto digits = [this]
+        {
+            auto b = p;
+            while (p != end && *p >= '0' && *p <= '9')
+                p++;
+            if (b == p)
+                error("bad number");
+        };
+        digits();
+        if (p != end && *p == '.')
+        {
+            p++;
+            digits();
+        }
+        if (p != end && (*p == 'e' || *p == 'E'))
+        {
+            p++;
+            if (p != end && (*p == '+' || *p == '-'))
+                p++;
+            digits();
+        }
+        v.type = JsonValue::Type::Number;
+        v.value.assign(b, p);
+    }
+
+    unsigned parseHex4()
+    {
+        if (end - p < 4)
+            error("bad unicode escape");
+        unsigned c = 0;
+        for (int i = 0; i < 4; i++, p++)
+        {
+            c <<= 4;
+            if (*p >= '0' && *p <= '9')
+                c |= *p - '0';
+            else if (*p >= 'a' && *p <= 'f')
+                c |= *p - 'a' + 10;
+            else if (*p >= 'A' && *p <= 'F')
+                c |= *p - 'A' + 10;
+            else
+                error("bad unicode escape");
+        }
+        return c;
+    }
+
+    static void appendUtf8(String &s, unsigned c)
+    {
+        if (c < 0x80)
+            s += (char)c;
+        else if (c < 0x800)
+        {
+            s += (char)(0xC0 | (c >> 6));
+            s += (char)(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            s += (char)(0xE0 | (c >> 12));
+            s += (char)(0x80 | ((c >> 6) & 0x3F));
+            s += (char)(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            s += (char)(0xF0 | (c >> 18));
+            s += (char)(0x80 | ((c >> 12) & 0x3F));
+            s += (char)(0x80 | ((c >> 6) & 0x3F));
+            s += (char)(0x80 | (c & 0x3F));
+        }
+    }
+
+    void parseString(String &s)
+    {
+        expect('"');
+        while (1)
+        {
+            // copy unescaped runs at once
+            auto b = p;
+            while (p != end && *p != '"' && *p != '\\')
+                p++;
+            s.append(b, p);
+            if (p == end)
+                error("unterminated string");
+            if (*p++ == '"')
+                return;
+            if (p == end)
+                error("unterminated string");
+            switch (*p++)
+            {
+            case '"': s += '"'; break;
+            case '\\': s += '\\'; break;
+            case '/': s += '/'; break;
+            case 'b': s += '\b'; break;
+            case 'f': s += '\f'; break;
+            case 'n': s += '\n'; break;
+            case 'r': s += '\r'; break;
+            case 't': s += '\t'; break;
+            case 'u':
+            {
+                auto c = parseHex4();
+                if (c >= 0xD800 && c <= 0xDBFF &&
+                    end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                {
+                    p += 2;
+                    auto lo = parseHex4();
+                    if (lo < 0xDC00 || lo > 0xDFFF)
+                        error("bad surrogate pair");
+                    c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                }
+                appendUtf8(s, c);
+                break;
+            }
+            default:
+                p--;
+                error("bad escape");
+            }
+        }
+    }
+};
+
+JsonValue::JsonValue(Type type)
+    : type(type)
+{
+}
+
+JsonValue::JsonValue(bool v)
+    : type(Type::Boolean), value(v ? "true" : "false")
+{
+}
+
+JsonValue::JsonValue(const char *v)
+    : type(Type::String), value(v)
+{
+}
+
+JsonValue::JsonValue(const String &v)
+    : type(Type::String), value(v)
+{
+}
+
+JsonValue::JsonValue(String &&v)
+    : type(Type::String), value(std::move(v))
+{
+}
+
+JsonValue::JsonValue(double v)
+    : type(Type::Number)
+{
+    std::ostringstream ss;
+    ss.precision(std::numeric_limits<double>::max_digits10);
+    ss << v;
+    value = ss.str();
+}
+
+JsonValue JsonValue::parse(const String &s)
+{
+    return JsonParser(s).parse();
+}
+
+const JsonValue::Array &JsonValue::getArray() const
+{
+    if (type != Type::Array)
+        throw std::runtime_error("json: value is not an array");
+    return array;
+}
+
+const JsonValue::Object &JsonValue::getObject() const
+{
+    if (type != Type::Object)
+        throw std::runtime_error("json: value is not an object");
+    return object;
+}
+
+const JsonValue *JsonValue::find(const String &key) const
+{
+    for (auto &m : object)
+    {
+        if (m.first == key)
+            return &m.second;
+    }
+    return nullptr;
+}
+
+const JsonValue &JsonValue::at(const String &key) const
+{
+    auto v = find(key);
+    if (!v)
+        throw std::runtime_error("json: no such member: " + key);
+    return *v;
+}
+
+JsonValue &JsonValue::operator[](const String &key)
+{
+    if (type == Type::Null)
+        type = Type::Object;
+    if (type != Type::Object)
+        throw std::runtime_error("json: value is not an object");
+    for (auto &m : object)
+    {
+        if (m.first == key)
+            return m.second;
+    }
+    object.emplace_back(key, JsonValue());
+    return object.back().second;
+}
+
+void JsonValue::push_back(JsonValue v)
+{
+    if (type == Type::Null)
+        type = Type::Array;
+    if (type != Type::Array)
+        throw std::runtime_error("json: value is not an array");
+    array.push_back(std::move(v));
+}
+
+size_t JsonValue::size() const
+{
+    switch (type)
+    {
+    case Type::Array:
+        return array.size();
+    case Type::Object:
+        return object.size();
+    default:
+        return 0;
+    }
+}
+
+const String &JsonValue::getScalar() const
+{
+    if (type == Type::Array || type == Type::Object)
+        throw std::runtime_error("json: value is not a scalar");
+    return value;
+}
+
+void JsonValue::convert(String &v) const
+{
+    v = getScalar();
+}
+
+void JsonValue::convert(bool &v) const
+{
+    auto &s = getScalar();
+    if (s == "true" || s == "1")
+        v = true;
+    else if (s == "false" || s == "0")
+        v = false;
+    else
+        throw std::runtime_error("json: bad boolean value: " + s);
+}
+
+template <class T, class F>
+static T convert_number(const String &s, F f)
+{
+    if (s.empty())
+        throw std::runtime_error("json: empty number");
+    char *e;
+    errno = 0;
+    auto v = f(s.c_str(), &e);
+    if (*e != 0 || errno == ERANGE ||
+        v < std::numeric_limits<T>::lowest() || v > std::numeric_limits<T>::max())
+        throw std::runtime_error("json: bad number: " + s);
+    return (T)v;
+}
+
+static long long strtoll10(const char *s, char **e) { return strtoll(s, e, 10); }
+static unsigned long long strtoull10(const char *s, char **e)
+{
+    // strtoull accepts negative numbers
+    if (*s == '-')
+    {
+        *e = (char *)s;
+        return 0;
+    }
+    return strtoull(s, e, 10);
+}
+
+void JsonValue::convert(double &v) const { v = convert_number<double>(getScalar(), strtod); }
+void JsonValue::convert(int &v) const { v = convert_number<int>(getScalar(), strtoll10); }
+void JsonValue::convert(unsigned &v) const { v = convert_number<unsigned>(getScalar(), strtoull10); }
+void JsonValue::convert(long &v) const { v = convert_number<long>(getScalar(), strtoll10); }
+void JsonValue::convert(unsigned long &v) const { v = convert_number<unsigned long>(getScalar(), strtoull10); }
+void JsonValue::convert(long long &v) const { v = convert_number<long long>(getScalar(), strtoll10); }
+void JsonValue::convert(unsigned long long &v) const { v = convert_number<unsigned long long>(getScalar(), strtoull10); }
+
+static void dump_string(String &s, const String &v)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    s += '"';
+    for (auto c : v)
+    {
+        switch (c)
+        {
+        case '"': s += "\\\""; break;
+        case '\\': s += "\\\\"; break;
+        case '\b': s += "\\b"; break;
+        case '\f': s += "\\f"; break;
+        case '\n': s += "\\n"; break;
+        case '\r': s += "\\r"; break;
+        case '\t': s += "\\t"; break;
+        default:
+            if ((unsigned char)c < 0x20)
+            {
+                s += "\\u00";
+                s += hex[(c >> 4) & 0xF];
+                s += hex[c & 0xF];
+            }
+            else
+                s += c;
+            break;
+        }
+    }
+    s += '"';
+}
+
+void JsonValue::dump(String &s) const
+{
+    switch (type)
+    {
+    case Type::Null:
+        s += "null";
+        break;
+    case Type::Boolean:
+    case Type::Number:
+        s += value;
+        break;
+    case Type::String:
+        dump_string(s, value);
+        break;
+    case Type::Array:
+    {
+        s += '[';
+        bool first = true;
+        for (auto &v : array)
+        {
+            if (!first)
+                s += ',';
+            first = false;
+            v.dump(s);
+        }
+        s += ']';
+        break;
+    }
+    case Type::Object:
+    {
+        s += '{';
+        bool first = true;
+        for (auto &m : object)
+        {
+            if (!first)
+                s += ',';
+            first = false;
+            dump_string(s, m.first);
+            s += ':';
+            m.second.dump(s);
+        }
+        s += '}';
+        break;
+    }
+    }
+}
+
+String JsonValue::dump() const
+{
+    String s;
+    dump(s);
+    return s;
+}
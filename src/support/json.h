@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <primitives/string.h>
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Small json DOM for api requests and responses.
+// Parsing is done in one pass without streams, member order is preserved.
+// Scalars keep their text, so numbers are converted only on access
+// and large ids do not lose precision.
+// Api requests send numbers as strings (as server expects).
+class JsonValue
+{
+public:
+    enum class Type
+    {
+        Null,
+        Boolean,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    using Array = std::vector<JsonValue>;
+    using Member = std::pair<String, JsonValue>;
+    using Object = std::vector<Member>;
+
+public:
+    JsonValue() = default;
+    JsonValue(Type type);
+    JsonValue(bool v);
+    JsonValue(const char *v);
+    JsonValue(const String &v);
+    JsonValue(String &&v);
+    JsonValue(double v);
+
+    template <class T, class = std::enable_if_t<std::is_integral<T>::value>>
+    JsonValue(T v)
+        : type(Type::Number), value(std::to_string(v))
+    {
+    }
+
+    static JsonValue parse(const String &s);
+    String dump() const;
+
+    Type getType() const { return type; }
+    bool isNull() const { return type == Type::Null; }
+    bool isObject() const { return type == Type::Object; }
+    bool isArray() const { return type == Type::Array; }
+
+    // throw on type mismatch
+    const Array &getArray() const;
+    const Object &getObject() const;
+
+    // returns nullptr when there is no such member
+    const JsonValue *find(const String &key) const;
+    // throws when there is no such member
+    const JsonValue &at(const String &key) const;
+    const JsonValue &operator[](const String &key) const { return at(key); }
+    // adds member if it is missing, turns null into an object
+    JsonValue &operator[](const String &key);
+    // turns null into an array
+    void push_back(JsonValue v);
+
+    size_t size() const;
+
+    template <class T>
+    T get() const
+    {
+        T v;
+        convert(v);
+        return v;
+    }
+
+    template <class T>
+    T get(const String &key) const
+    {
+        return at(key).get<T>();
+    }
+
+    template <class T>
+    T get(const String &key, const T &default_value) const
+    {
+        auto v = find(key);
+        if (!v || v->isNull())
+            return default_value;
+        return v->get<T>();
+    }
+
+    String get(const String &key, const char *default_value) const
+    {
+        return get<String>(key, default_value);
+    }
+
+private:
+    Type type = Type::Null;
+    String value;
+    Array array;
+    Object object;
+
+    friend class JsonParser;
+
+    const String &getScalar() const;
+    void convert(String &v) const;
+    void convert(bool &v) const;
+    void convert(double &v) const;
+    void convert(int &v) const;
+    void convert(unsigned &v) const;
+    void convert(long &v) const;
+    void convert(unsigned long &v) const;
+    void convert(long long &v) const;
+    void convert(unsigned long long &v) const;
+
+    void dump(String &s) const;
+};
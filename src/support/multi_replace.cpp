@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "multi_replace.h"
+
+#include <boost/algorithm/string.hpp>
+
+#include <queue>
+
+// suffix of a is a prefix of b
+static bool has_border(const String &a, const String &b)
+{
+    auto n = std::min(a.size(), b.size());
+    for (size_t i = 1; i < n; i++)
+    {
+        if (a.compare(a.size() - i, i, b, 0, i) == 0)
+            return true;
+    }
+    return false;
+}
+
+// a and b can give matches that share some characters
+static bool overlaps(const String &a, const String &b)
+{
+    if (a.find(b) != a.npos || b.find(a) != b.npos)
+        return true;
+    return has_border(a, b) || has_border(b, a);
+}
+
+MultiReplacer::MultiReplacer(const Replacements &r)
+{
+    // empty patterns are ignored by replace_all()
+    for (auto &p : r)
+    {
+        if (!p.first.empty())
+            replacements.push_back(p);
+    }
+
+    for (size_t i = 0; i < replacements.size() && single_pass; i++)
+    {
+        for (size_t j = i; j < replacements.size() && single_pass; j++)
+        {
+            if (i == j)
+            {
+                // self overlapping pattern, e.g. 'aa' in 'aaa'
+                if (has_border(replacements[i].first, replacements[i].first))
+                    single_pass = false;
+                continue;
+            }
+            if (overlaps(replacements[i].first, replacements[j].first))
+                single_pass = false;
+            // replacement can create the next pattern
+            else if (replacements[i].second.empty() || overlaps(replacements[i].second, replacements[j].first))
+                single_pass = false;
+        }
+    }
+
+    // trie
+    std::array<int, 256> empty;
+    empty.fill(-1);
+    delta.push_back(empty);
+    out.push_back(-1);
+    for (size_t i = 0; i < replacements.size(); i++)
+    {
+        int s = 0;
+        for (unsigned char c : replacements[i].first)
+        {
+            if (delta[s][c] == -1)
+            {
+                delta[s][c] = (int)delta.size();
+                delta.push_back(empty);
+                out.push_back(-1);
+            }
+            s = delta[s][c];
+        }
+        // first pattern wins on duplicates, as it is applied first
+        if (out[s] == -1)
+            out[s] = (int)i;
+    }
+
+    // failure links are folded into full transition table
+    std::vector<int> fail(delta.size(), 0);
+    dict.assign(delta.size(), -1);
+    std::queue<int> q;
+    for (auto &t : delta[0])
+    {
+        if (t == -1)
+            t = 0;
+        else
+            q.push(t);
+    }
+    while (!q.empty())
+    {
+        auto s = q.front();
+        q.pop();
+        for (int c = 0; c < 256; c++)
+        {
+            auto &t = delta[s][c];
+            if (t == -1)
+            {
+                t = delta[fail[s]][c];
+                continue;
+            }
+            fail[t] = delta[fail[s]][c];
+            dict[t] = out[fail[t]] != -1 ? fail[t] : dict[fail[t]];
+            q.push(t);
+        }
+    }
+}
+
+int MultiReplacer::findFirst(const String &s) const
+{
+    int first = -1;
+    int state = 0;
+    for (unsigned char c : s)
+    {
+        state = delta[state][c];
+        for (auto d = out[state] != -1 ? state : dict[state]; d != -1; d = dict[d])
+        {
+            if (first == -1 || out[d] < first)
+                first = out[d];
+        }
+        if (first == 0)
+            break;
+    }
+    return first;
+}
+
+bool MultiReplacer::replace(String &s) const
+{
+    if (replacements.empty())
+        return false;
+
+    if (!single_pass)
+    {
+        auto first = findFirst(s);
+        if (first == -1)
+            return false;
+        for (size_t i = first; i < replacements.size(); i++)
+            boost::replace_all(s, replacements[i].first, replacements[i].second);
+        return true;
+    }
+
+    // patterns do not overlap, so every match is final
+    String r;
+    size_t last = 0;
+    int state = 0;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        state = delta[state][(unsigned char)s[i]];
+        auto k = out[state];
+        if (k == -1)
+            continue;
+        if (r.empty())
+            r.reserve(s.size());
+        auto start = i + 1 - replacements[k].first.size();
+        r.append(s, last, start - last);
+        r += replacements[k].second;
+        last = i + 1;
+        state = 0;
+    }
+    if (last == 0)
+        return false;
+    r.append(s, last, s.npos);
+    s = std::move(r);
+    return true;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2016-2017, Egor Pugin
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <primitives/string.h>
+
+#include <array>
+#include <utility>
+#include <vector>
+
+// Replaces several literal patterns in one pass using Aho-Corasick automaton.
+// Result is the same as of sequential boost::replace_all() calls.
+// When patterns or replacements can interfere (overlap, chain),
+// those calls are done, but only starting from the first found pattern.
+class MultiReplacer
+{
+public:
+    using Replacements = std::vector<std::pair<String, String>>;
+
+    MultiReplacer(const Replacements &replacements);
+
+    // returns false if nothing was found
+    bool replace(String &s) const;
+
+    bool empty() const { return replacements.empty(); }
+    bool isSinglePass() const { return single_pass; }
+
+private:
+    Replacements replacements;
+    std::vector<std::array<int, 256>> delta;
+    std::vector<int> out; // pattern index or -1
+    std::vector<int> dict; // next state with output on the suffix chain or -1
+    bool single_pass = true;
+
+    // index of the first pattern found in s or -1
+    int findFirst(const String &s) const;
+};
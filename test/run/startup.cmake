@@ -0,0 +1,33 @@
+#
+# cppan
+#
+
+# checks that internal commands do not initialize the whole client
+
+set(dir ${CMAKE_CURRENT_BINARY_DIR}/startup)
+file(MAKE_DIRECTORY ${dir})
+file(WRITE ${dir}/aliases.txt "")
+file(WRITE ${dir}/old.cmake "")
+
+execute_process(
+    COMMAND ${CPPAN_COMMAND} internal-fix-imports pvt.cppan.demo.startup-1.0.0
+        ${dir}/aliases.txt ${dir}/old.cmake ${dir}/new.cmake --time-startup
+    RESULT_VARIABLE r
+    ERROR_VARIABLE out
+)
+if (r)
+    message(FATAL_ERROR "internal-fix-imports failed: ${out}")
+endif()
+
+foreach(stage logger "service db")
+    if ("${out}" MATCHES "startup: ${stage}:")
+        message(FATAL_ERROR "internal-fix-imports initialized ${stage}:\n${out}")
+    endif()
+endforeach()
+
+if (NOT "${out}" MATCHES "startup: total: ([0-9]+) us")
+    message(FATAL_ERROR "No startup report:\n${out}")
+endif()
+if (CMAKE_MATCH_1 GREATER ${BUDGET_US})
+    message(FATAL_ERROR "Startup took ${CMAKE_MATCH_1} us, budget is ${BUDGET_US} us:\n${out}")
+endif()
@@ -0,0 +1,77 @@
+#include <background.h>
+#include <http_session.h>
+
+#include <boost/asio.hpp>
+
+#include <thread>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch.hpp>
+
+using namespace std::literals;
+
+using TestClock = std::chrono::steady_clock;
+
+TEST_CASE("slow endpoint does not block foreground", "[background]")
+{
+    // stand-in endpoint: connections are queued, but never answered
+    boost::asio::io_service io;
+    boost::asio::ip::tcp::acceptor acceptor(io,
+        boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    auto url = "http://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()) + "/";
+
+    std::atomic_bool started{ false };
+    std::atomic_long http_code{ -1 };
+    auto start = TestClock::now();
+    run_background([&url, &started, &http_code](const auto &cancel)
+    {
+        started = true;
+        HttpRequest req;
+        req.url = url;
+        http_code = getHttpSession().request(req, &cancel).http_code;
+    }, 10s);
+    REQUIRE(TestClock::now() - start < 100ms);
+
+    // foreground work goes on
+    while (!started)
+        std::this_thread::sleep_for(1ms);
+    REQUIRE(http_code == -1);
+
+    wait_background(200ms);
+    REQUIRE(TestClock::now() - start < 2s);
+    REQUIRE(http_code == 0);
+}
+
+TEST_CASE("finished task is not delayed", "[background]")
+{
+    std::atomic_int value{ 0 };
+    auto start = TestClock::now();
+    run_background([&value](const auto &)
+    {
+        value = 1;
+    });
+    wait_background(10s);
+    REQUIRE(value == 1);
+    REQUIRE(TestClock::now() - start < 1s);
+}
+
+TEST_CASE("deadline cancels task", "[background]")
+{
+    std::atomic_bool cancelled{ false };
+    auto start = TestClock::now();
+    run_background([&cancelled](const auto &cancel)
+    {
+        while (!cancel)
+            std::this_thread::sleep_for(1ms);
+        cancelled = true;
+    }, 100ms);
+    wait_background(10s);
+    REQUIRE(cancelled);
+    REQUIRE(TestClock::now() - start < 1s);
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
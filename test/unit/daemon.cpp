@@ -0,0 +1,157 @@
+#include <daemon.h>
+#include <filesystem.h>
+
+#include <boost/algorithm/string.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define CATCH_CONFIG_RUNNER
+#include <catch.hpp>
+
+#ifndef _WIN32
+
+using namespace std::literals;
+
+struct TestDaemon
+{
+    std::thread t;
+
+    TestDaemon(const DaemonCommand &command)
+    {
+        t = std::thread([command] { run_daemon(command); });
+        // wait until it listens
+        for (int i = 0; i < 500 && !run_in_daemon({ "cppan", "internal-fix-imports", "ping" }); i++)
+            std::this_thread::sleep_for(10ms);
+    }
+
+    ~TestDaemon()
+    {
+        stop_daemon();
+        t.join();
+    }
+};
+
+struct CaptureOutput
+{
+    std::ostringstream out, err;
+    std::streambuf *old_out = std::cout.rdbuf(out.rdbuf());
+    std::streambuf *old_err = std::cerr.rdbuf(err.rdbuf());
+
+    ~CaptureOutput()
+    {
+        std::cout.rdbuf(old_out);
+        std::cerr.rdbuf(old_err);
+    }
+};
+
+TEST_CASE("command is executed in process without daemon", "[daemon]")
+{
+    REQUIRE(!run_in_daemon({ "cppan", "internal-fix-imports", "a" }));
+}
+
+TEST_CASE("only short commands are sent", "[daemon]")
+{
+    std::atomic_int n{ 0 };
+    TestDaemon d([&n](const Strings &) { n++; return 0; });
+    n = 0;
+    REQUIRE(!run_in_daemon({ "cppan", "internal-parallel-moc", "a" }));
+    REQUIRE(!run_in_daemon({ "cppan", "build" }));
+    REQUIRE(n == 0);
+}
+
+TEST_CASE("client context is forwarded", "[daemon]")
+{
+    TestDaemon d([](const Strings &args)
+    {
+        if (args.size() < 3 || args[2] != "test")
+            return 0;
+        auto v = getenv("CPPAN_DAEMON_TEST");
+        std::cout << (v ? v : "") << " " << fs::current_path().filename().string();
+        std::cerr << "err";
+        return 5;
+    });
+
+    auto dir = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(dir);
+    auto old = fs::current_path();
+    fs::current_path(dir);
+    setenv("CPPAN_DAEMON_TEST", "value", 1);
+
+    optional<int> r;
+    String out, err;
+    {
+        CaptureOutput c;
+        r = run_in_daemon({ "cppan", "internal-fix-imports", "test" });
+        out = c.out.str();
+        err = c.err.str();
+    }
+
+    fs::current_path(old);
+    fs::remove_all(dir);
+    unsetenv("CPPAN_DAEMON_TEST");
+
+    REQUIRE(r);
+    REQUIRE(r.value() == 5);
+    REQUIRE(out == "value " + dir.filename().string());
+    // daemon log may go to the same stream in this test
+    REQUIRE(boost::ends_with(err, "err"));
+    // daemon environment is restored
+    REQUIRE(!getenv("CPPAN_DAEMON_TEST"));
+}
+
+TEST_CASE("busy daemon is not waited", "[daemon]")
+{
+    std::atomic_int n{ 0 };
+    TestDaemon d([&n](const Strings &args)
+    {
+        if (args.size() > 2 && args[2] == "slow")
+            std::this_thread::sleep_for(2s);
+        if (args.size() > 2 && args[2] == "fast")
+            n++;
+        return 0;
+    });
+
+    std::thread slow([] { run_in_daemon({ "cppan", "internal-fix-imports", "slow" }); });
+    std::this_thread::sleep_for(200ms);
+    auto start = std::chrono::steady_clock::now();
+    REQUIRE(!run_in_daemon({ "cppan", "internal-fix-imports", "fast" }));
+    REQUIRE(std::chrono::steady_clock::now() - start < 1500ms);
+    slow.join();
+    // given up request is not executed later
+    std::this_thread::sleep_for(200ms);
+    REQUIRE(n == 0);
+}
+
+TEST_CASE("socket accessible by others is not used", "[daemon]")
+{
+    TestDaemon d([](const Strings &) { return 0; });
+    REQUIRE(run_in_daemon({ "cppan", "internal-fix-imports", "a" }));
+
+    path socket;
+    for (fs::directory_iterator i(fs::temp_directory_path()), e; i != e; ++i)
+    {
+        auto fn = i->path().filename().string();
+        if (fn.find("cppan_" + std::to_string(getuid()) + "_") == 0 && i->path().extension() == ".sock")
+            socket = i->path();
+    }
+    REQUIRE(!socket.empty());
+    fs::permissions(socket, fs::all_all);
+    REQUIRE(!run_in_daemon({ "cppan", "internal-fix-imports", "a" }));
+    fs::permissions(socket, fs::owner_all);
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
@@ -0,0 +1,71 @@
+#include <download.h>
+
+#include "http_server.h"
+
+#include <boost/algorithm/string.hpp>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch.hpp>
+
+struct TempFile
+{
+    path fn = fs::temp_directory_path() / fs::unique_path();
+
+    ~TempFile()
+    {
+        boost::system::error_code ec;
+        fs::remove(fn, ec);
+        fs::remove(path(fn) += ".part", ec);
+        fs::remove(path(fn) += ".part.validator", ec);
+    }
+};
+
+TEST_CASE("small file is downloaded with one request", "[download]")
+{
+    TestHttpServer srv([](const auto &)
+    {
+        return TestHttpServer::response("0123456789", "200 OK", "Accept-Ranges: bytes\r\n");
+    });
+
+    TempFile f;
+    download_file_resumable(srv.url(), f.fn);
+    REQUIRE(read_file(f.fn) == "0123456789");
+    REQUIRE(srv.n_requests == 1);
+}
+
+TEST_CASE("interrupted transfer is resumed", "[download]")
+{
+    TestHttpServer srv([](const auto &req)
+    {
+        const std::string headers = "ETag: \"v1\"\r\nAccept-Ranges: bytes\r\n";
+        if (boost::icontains(req, "Range: bytes=5-"))
+            return TestHttpServer::response("56789", "206 Partial Content", headers + "Content-Range: bytes 5-9/10\r\n");
+        // connection is dropped in the middle
+        return TestHttpServer::response("01234", "200 OK", headers, 10);
+    });
+
+    TempFile f;
+    download_file_resumable(srv.url(), f.fn);
+    REQUIRE(read_file(f.fn) == "0123456789");
+    REQUIRE(srv.n_requests == 2);
+    REQUIRE(boost::icontains(srv.last_request(), "If-Range: \"v1\""));
+}
+
+TEST_CASE("too big file is not retried", "[download]")
+{
+    TestHttpServer srv([](const auto &)
+    {
+        return TestHttpServer::response("0123456789");
+    });
+
+    TempFile f;
+    REQUIRE_THROWS_WITH(download_file_resumable(srv.url(), f.fn, 5), Catch::Contains("too big"));
+    REQUIRE(srv.n_requests == 1);
+    REQUIRE(!fs::exists(path(f.fn) += ".part"));
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
@@ -0,0 +1,105 @@
+#include <hedged.h>
+#include <http_session.h>
+#include <resolver.h>
+
+#include "http_server.h"
+
+#include <thread>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch.hpp>
+
+using namespace std::literals;
+
+static HedgeResult query(const String &url, const std::atomic_bool &cancel)
+{
+    HttpRequest req;
+    req.url = url;
+    req.timeout = 10;
+    auto resp = getHttpSession().request(req, &cancel);
+    return resp.http_code == 200 ? HedgeResult::Success : HedgeResult::Failure;
+}
+
+TEST_CASE("hedge delay", "[hedged]")
+{
+    RemotesHealth health;
+    auto unknown = get_remote_hedge_delay(health, "a");
+    REQUIRE(unknown >= 1s);
+
+    health["a"].latency = 10;
+    REQUIRE(get_remote_hedge_delay(health, "a") >= 1s);
+    health["a"].latency = 100000;
+    REQUIRE(get_remote_hedge_delay(health, "a") <= unknown);
+}
+
+TEST_CASE("slow first remote is not doubled", "[hedged]")
+{
+    TestHttpServer s1([](const auto &)
+    {
+        std::this_thread::sleep_for(500ms);
+        return TestHttpServer::response("{}");
+    });
+    TestHttpServer s2([](const auto &) { return TestHttpServer::response("{}"); });
+    std::vector<String> urls{ s1.url(), s2.url() };
+
+    RemotesHealth health;
+    auto winner = hedged_race(urls.size(),
+        [&urls, &health](size_t i) { return get_remote_hedge_delay(health, urls[i]); },
+        [&urls](size_t i, const std::atomic_bool &cancel) { return query(urls[i], cancel); });
+    REQUIRE(winner == 0);
+    REQUIRE(s1.n_requests == 1);
+    REQUIRE(s2.n_requests == 0);
+}
+
+TEST_CASE("stuck remote is hedged", "[hedged]")
+{
+    // connections are queued, but never answered
+    boost::asio::io_service io;
+    boost::asio::ip::tcp::acceptor acceptor(io,
+        boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    TestHttpServer s2([](const auto &) { return TestHttpServer::response("{}"); });
+    std::vector<String> urls{
+        "http://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()) + "/",
+        s2.url() };
+
+    RemotesHealth health;
+    health[urls[0]].latency = 100;
+    auto start = std::chrono::steady_clock::now();
+    auto winner = hedged_race(urls.size(),
+        [&urls, &health](size_t i) { return get_remote_hedge_delay(health, urls[i]); },
+        [&urls](size_t i, const std::atomic_bool &cancel) { return query(urls[i], cancel); });
+    REQUIRE(winner == 1);
+    REQUIRE(std::chrono::steady_clock::now() - start < 5s);
+}
+
+TEST_CASE("progressing task is not hedged", "[hedged]")
+{
+    std::atomic_int progress{ 0 };
+    int last = -1;
+    std::atomic_int n_started{ 0 };
+    auto winner = hedged_race(2,
+        [](size_t) { return 50ms; },
+        [&progress, &n_started](size_t i, const std::atomic_bool &cancel)
+    {
+        n_started++;
+        if (i)
+            return HedgeResult::Success;
+        for (int j = 0; j < 20 && !cancel; j++, progress++)
+            std::this_thread::sleep_for(10ms);
+        return HedgeResult::Success;
+    },
+        [&progress, &last](size_t)
+    {
+        auto stalled = progress == last;
+        last = progress;
+        return stalled;
+    });
+    REQUIRE(winner == 0);
+    REQUIRE(n_started == 1);
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
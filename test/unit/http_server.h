@@ -0,0 +1,96 @@
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// stand-in server
+// each connection gets one raw response from the handler and is closed,
+// so a short body can be used to drop the transfer in the middle
+class TestHttpServer
+{
+public:
+    using Handler = std::function<std::string(const std::string &request)>;
+
+    TestHttpServer(Handler handler)
+        : acceptor(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+        handler(handler)
+    {
+        t = std::thread([this] { run(); });
+    }
+
+    ~TestHttpServer()
+    {
+        stopped = true;
+        // wake up accept()
+        boost::system::error_code ec;
+        boost::asio::ip::tcp::socket s(io);
+        s.connect(acceptor.local_endpoint(), ec);
+        t.join();
+    }
+
+    std::string url(const std::string &p = "/") const
+    {
+        return "http://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()) + p;
+    }
+
+    static std::string response(const std::string &body, const std::string &status = "200 OK",
+        const std::string &headers = "", size_t content_length = -1)
+    {
+        if (content_length == -1)
+            content_length = body.size();
+        return "HTTP/1.1 " + status + "\r\n" +
+            "Content-Length: " + std::to_string(content_length) + "\r\n" +
+            "Connection: close\r\n" +
+            headers +
+            "\r\n" +
+            body;
+    }
+
+    // last request headers (lowercase is not applied)
+    std::string last_request() const
+    {
+        std::lock_guard<std::mutex> lk(m);
+        return last;
+    }
+
+    std::atomic_int n_requests{ 0 };
+
+private:
+    boost::asio::io_service io;
+    boost::asio::ip::tcp::acceptor acceptor;
+    Handler handler;
+    std::thread t;
+    std::atomic_bool stopped{ false };
+    mutable std::mutex m;
+    std::string last;
+
+    void run()
+    {
+        while (!stopped)
+        {
+            boost::system::error_code ec;
+            boost::asio::ip::tcp::socket s(io);
+            acceptor.accept(s, ec);
+            if (ec || stopped)
+                continue;
+
+            boost::asio::streambuf buf;
+            boost::asio::read_until(s, buf, "\r\n\r\n", ec);
+            if (ec)
+                continue;
+            std::string req{ boost::asio::buffers_begin(buf.data()), boost::asio::buffers_end(buf.data()) };
+            {
+                std::lock_guard<std::mutex> lk(m);
+                last = req;
+            }
+            n_requests++;
+            boost::asio::write(s, boost::asio::buffer(handler(req)), ec);
+            s.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+        }
+    }
+};
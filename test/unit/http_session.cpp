@@ -0,0 +1,83 @@
+#include <http_session.h>
+
+#include "http_server.h"
+
+#include <boost/algorithm/string.hpp>
+
+#define CATCH_CONFIG_RUNNER
+#include <catch.hpp>
+
+TEST_CASE("transport error is reported", "[http_session]")
+{
+    std::string url;
+    {
+        // port is free after the server is gone
+        TestHttpServer srv([](const auto &) { return std::string(); });
+        url = srv.url();
+    }
+
+    HttpRequest req;
+    req.url = url;
+    req.connect_timeout = 2;
+    auto resp = getHttpSession().request(req);
+    REQUIRE(resp.http_code == 0);
+    REQUIRE(!resp.error.empty());
+}
+
+TEST_CASE("response is returned", "[http_session]")
+{
+    TestHttpServer srv([](const auto &)
+    {
+        return TestHttpServer::response("42");
+    });
+
+    HttpRequest req;
+    req.url = srv.url();
+    auto resp = getHttpSession().request(req);
+    REQUIRE(resp.http_code == 200);
+    REQUIRE(resp.response == "42");
+    REQUIRE(resp.error.empty());
+}
+
+TEST_CASE("server errors are retried", "[http_session]")
+{
+    TestHttpServer srv([](const auto &)
+    {
+        return TestHttpServer::response("", "503 Service Unavailable");
+    });
+
+    HttpRequest req;
+    req.url = srv.url();
+    auto resp = getHttpSession().request(req, 2);
+    REQUIRE(resp.http_code == 503);
+    REQUIRE(srv.n_requests == 2);
+}
+
+TEST_CASE("downloads are not compressed", "[http_session]")
+{
+    TestHttpServer srv([](const auto &)
+    {
+        return TestHttpServer::response("data");
+    });
+
+    HttpRequest req;
+    req.url = srv.url();
+    getHttpSession().request(req);
+    REQUIRE(boost::icontains(srv.last_request(), "Accept-Encoding:"));
+
+    auto fn = fs::temp_directory_path() / fs::unique_path();
+    std::atomic<uintmax_t> received{ 0 };
+    HttpDownload opts;
+    opts.received = &received;
+    auto info = getHttpSession().download(req, fn, opts);
+    REQUIRE(info.http_code == 200);
+    REQUIRE(!boost::icontains(srv.last_request(), "Accept-Encoding:"));
+    REQUIRE(received == 4);
+    fs::remove(fn);
+}
+
+int main(int argc, char **argv)
+{
+    auto rc = Catch::Session().run(argc, argv);
+    return rc;
+}
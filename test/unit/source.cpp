@@ -1,3 +1,4 @@
+#include <archive_provider.h>
 #include <source.h>
 
 #include <sstream>
@@ -32,6 +33,26 @@ TEST_CASE("save/load", "[source]")
     REQUIRE_NOTHROW(save_source(p, f));
 }
 
+TEST_CASE("archive urls", "[source]")
+{
+    auto p = get_default_archive_providers();
+    REQUIRE(get_archive_url(p, "https://github.com/madler/zlib.git", "v1.2.11") ==
+        "https://github.com/madler/zlib/archive/v1.2.11.tar.gz");
+    REQUIRE(get_archive_url(p, "https://gitlab.com/group/project/", "master") ==
+        "https://gitlab.com/group/project/-/archive/master/project-master.tar.gz");
+    REQUIRE(get_archive_url(p, "https://bitbucket.org/user/repo", "abcdef") ==
+        "https://bitbucket.org/user/repo/get/abcdef.tar.gz");
+
+    // no provider, no ref or not http
+    REQUIRE(get_archive_url(p, "https://example.com/user/repo", "v1").empty());
+    REQUIRE(get_archive_url(p, "https://github.com/user/repo", "").empty());
+    REQUIRE(get_archive_url(p, "git@github.com:user/repo.git", "v1").empty());
+
+    p["git.example.com"] = "{url}/snapshot/{name}-{ref}.tar.gz";
+    REQUIRE(get_archive_url(p, "https://git.example.com/pub/repo.git", "v1") ==
+        "https://git.example.com/pub/repo/snapshot/repo-v1.tar.gz");
+}
+
 int main(int argc, char **argv)
 {
     auto rc = Catch::Session().run(argc, argv);
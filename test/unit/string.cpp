@@ -1,4 +1,6 @@
 #include <cppan_string.h>
+#include <json.h>
+#include <multi_replace.h>
 
 #define CATCH_CONFIG_RUNNER
 #include <catch.hpp>
@@ -17,6 +19,52 @@ dfgdf
     REQUIRE(e == 1445);
 }
 
+TEST_CASE("multi replace", "[string]")
+{
+    {
+        MultiReplacer r({ { "foo", "bar" }, { "x", "yy" } });
+        REQUIRE(r.isSinglePass());
+        String s = "foo x foox";
+        REQUIRE(r.replace(s));
+        REQUIRE(s == "bar yy baryy");
+        String s2 = "nothing";
+        REQUIRE_FALSE(r.replace(s2));
+        REQUIRE(s2 == "nothing");
+    }
+
+    {
+        // second pattern is created by the first replacement
+        MultiReplacer r({ { "a", "b" }, { "bc", "d" } });
+        REQUIRE_FALSE(r.isSinglePass());
+        String s = "ac";
+        REQUIRE(r.replace(s));
+        REQUIRE(s == "d");
+    }
+}
+
+TEST_CASE("json", "[string]")
+{
+    auto j = JsonValue::parse(R"({"api": 1, "info": "a\n\u00e9", "packages": {"pvt.a.b": {"id": 18446744073709551615, "dependencies": [1, 2]}}})");
+    REQUIRE(j.get<int>("api") == 1);
+    REQUIRE(j.get<String>("info") == "a\n\xC3\xA9");
+    REQUIRE(j.get("error", "") == "");
+    auto &p = j.at("packages").getObject();
+    REQUIRE(p.size() == 1);
+    REQUIRE(p[0].first == "pvt.a.b");
+    REQUIRE(p[0].second.get<uint64_t>("id") == 18446744073709551615ULL);
+    REQUIRE(p[0].second["dependencies"].size() == 2);
+    REQUIRE_THROWS(JsonValue::parse("[1,]"));
+    REQUIRE_THROWS(JsonValue::parse("{\"a\":1} x"));
+    REQUIRE_THROWS(JsonValue::parse(""));
+    REQUIRE_THROWS(j.at("packages").at("pvt.a.c"));
+
+    JsonValue r;
+    r["auth"]["user"] = "u\"";
+    r["vids"].push_back(5);
+    REQUIRE(r.dump() == R"({"auth":{"user":"u\""},"vids":[5]})");
+    REQUIRE(JsonValue::parse(r.dump()).dump() == r.dump());
+}
+
 int main(int argc, char **argv)
 {
     auto rc = Catch::Session().run(argc, argv);